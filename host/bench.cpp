@@ -0,0 +1,222 @@
+//
+//  bench: rep detection accuracy, latency and throughput as JSON
+//    Runs checkSwichStatus() + the rep counter over labeled traces, the synthetic
+//    corpus (synth.h) by default, and matches every counted rep to a true press.
+//      precision  counted reps that belong to a press / counted reps
+//      recall     presses that got counted / presses that should count
+//      latency    press start (label) to the sample the detection fired on
+//    Compare two firmware versions with: make bench-run > a.json, diff / jq.
+//
+//  usage: bench [-m any|alt] [labeled_trace.txt ...]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include "sampler.h"
+#include "detector.h"
+#include "detection.h"
+#include "detection_params.h"
+#include "sensor_task.h"
+#include "rep_counter.h"
+#include "synth.h"
+#include "trace.h"
+
+#ifndef BENCH_VERSION
+#define BENCH_VERSION "unknown"
+#endif
+
+static const uint16_t noBaseline[sampleChannels] = {0};
+static const uint32_t benchMatchUs = 1000000; // A rep counted later than 1s after the press is a miss
+
+struct BenchResult
+{
+    int presses;  // Presses that should count
+    int counted;
+    int matched;
+    std::vector<uint32_t> latencyUs;
+    std::vector<int32_t> onsetErrUs; // Event time - label time
+    size_t samples;
+    double wallSec;
+};
+
+// Presses the count mode should turn into reps: "alt" ignores a repeat on the same pad
+static int benchExpected(const std::vector<TraceLabel> &labels, CountMode mode)
+{
+    int expected = 0;
+    int lastSide = -1;
+
+    for (const TraceLabel &label : labels)
+    {
+        if (mode != countAlternate || label.side != lastSide)
+            expected++;
+        lastSide = label.side;
+    }
+    return expected;
+}
+
+static void benchRun(const std::vector<AdcSample> &trace, const std::vector<TraceLabel> &labels,
+                     CountMode mode, BenchResult &result)
+{
+    static Detection det;
+    uint8_t swStatus[sampleChannels] = {0};
+    uint32_t edgeUs[sampleChannels];
+    std::vector<RepEvent> reps;
+    std::vector<uint32_t> detectUs;
+
+    detectionBegin(det, noBaseline, detectionTuned);
+    repCounterBegin(mode);
+    auto start = std::chrono::steady_clock::now();
+    for (const AdcSample &sample : trace)
+    {
+        uint32_t changed = checkSwichStatus(det, swStatus, sample, edgeUs);
+        while (changed != 0)
+        {
+            int side = __builtin_ctz(changed);
+            RepEvent ev = {edgeUs[side], (uint8_t)side,
+                           swStatus[side] ? repEventPress : repEventRelease, 0};
+            if (repCounterEvent(ev))
+            {
+                reps.push_back(ev);
+                detectUs.push_back(sample.timeUs);
+            }
+            changed &= changed - 1;
+        }
+    }
+    result.wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.samples = trace.size();
+    result.presses = benchExpected(labels, mode);
+    result.counted = reps.size();
+    result.matched = 0;
+    result.latencyUs.clear();
+    result.onsetErrUs.clear();
+
+    // Each rep takes the earliest free press on its side it can belong to
+    std::vector<bool> used(labels.size(), false);
+    for (size_t i = 0; i < reps.size(); i++)
+    {
+        for (size_t j = 0; j < labels.size(); j++)
+        {
+            const TraceLabel &label = labels[j];
+            if (used[j] || label.side != reps[i].side || detectUs[i] < label.timeUs ||
+                detectUs[i] - label.timeUs > benchMatchUs)
+                continue;
+            used[j] = true;
+            result.matched++;
+            result.latencyUs.push_back(detectUs[i] - label.timeUs);
+            result.onsetErrUs.push_back((int32_t)(reps[i].timeUs - label.timeUs));
+            break;
+        }
+    }
+}
+
+static double benchPercentileMs(const std::vector<uint32_t> &sorted, int percent)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[(sorted.size() - 1) * percent / 100] / 1e3;
+}
+
+static void benchPrint(const char *name, CountMode mode, BenchResult &r, bool last)
+{
+    static const char *const modeNames[countModes] = {"any", "alt", "both"};
+    std::vector<uint32_t> &lat = r.latencyUs;
+    double latSum = 0;
+    double errSum = 0;
+
+    std::sort(lat.begin(), lat.end());
+    for (uint32_t v : lat)
+        latSum += v;
+    for (int32_t v : r.onsetErrUs)
+        errSum += v < 0 ? -v : v;
+    printf("    {\"name\": \"%s\", \"mode\": \"%s\", \"presses\": %d, \"counted\": %d, "
+           "\"matched\": %d,\n", name, modeNames[mode], r.presses, r.counted, r.matched);
+    printf("     \"precision\": %.4f, \"recall\": %.4f,\n",
+           r.counted ? (double)r.matched / r.counted : 1.0,
+           r.presses ? (double)r.matched / r.presses : 1.0);
+    printf("     \"latency_ms\": {\"mean\": %.2f, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, "
+           "\"max\": %.2f}, \"onset_err_ms\": %.2f,\n",
+           lat.empty() ? 0 : latSum / lat.size() / 1e3, benchPercentileMs(lat, 50),
+           benchPercentileMs(lat, 90), benchPercentileMs(lat, 99), benchPercentileMs(lat, 100),
+           r.onsetErrUs.empty() ? 0 : errSum / r.onsetErrUs.size() / 1e3);
+    printf("     \"samples\": %zu, \"samples_per_sec\": %.0f}%s\n", r.samples,
+           r.wallSec > 0 ? r.samples / r.wallSec : 0, last ? "" : ",");
+}
+
+static bool parseMode(const char *name, CountMode &mode)
+{
+    static const char *const names[countModes] = {"any", "alt", "both"};
+
+    for (int i = 0; i < countModes; i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            mode = (CountMode)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    CountMode mode = countAny;
+    int opt;
+    BenchResult result;
+    std::vector<AdcSample> trace;
+    std::vector<TraceLabel> labels;
+
+    while ((opt = getopt(argc, argv, "m:")) != -1)
+    {
+        // Labels are single presses, "both" has nothing to match against
+        if (opt != 'm' || !parseMode(optarg, mode) || mode == countBoth)
+        {
+            fprintf(stderr, "usage: %s [-m any|alt] [labeled_trace.txt ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("{\n  \"version\": \"%s\",\n", BENCH_VERSION);
+    printf("  \"config\": {\"sample_rate_hz\": %d, \"median_taps\": %d, \"lowpass_shift\": %d, "
+           "\"slope_span\": %d, \"press_ratio\": %d, \"release_ratio\": %d, \"dwell_samples\": %d, "
+           "\"min_age_ms\": %d, \"slope_q8\": %d},\n",
+           (int)sampleRateHz, filterMedianTaps, filterLowPassShift, filterSlopeSpan,
+           detectionTuned.pressRatio, detectionTuned.releaseRatio, detectionTuned.dwellSamples,
+           detectionTuned.minAgeMs, (int)detectionTuned.slopeQ8);
+    printf("  \"scenarios\": [\n");
+    if (optind < argc)
+    {
+        for (int i = optind; i < argc; i++)
+        {
+            trace.clear();
+            labels.clear();
+            if (!traceLoad(argv[i], trace) || !traceLoadLabels(argv[i], labels))
+            {
+                fprintf(stderr, "cannot read %s\n", argv[i]);
+                return 1;
+            }
+            benchRun(trace, labels, mode, result);
+            benchPrint(argv[i], mode, result, i == argc - 1);
+        }
+    }
+    else
+    {
+        std::vector<SynthPress> presses;
+
+        for (int i = 0; i < synthCorpusSize; i++)
+        {
+            const SynthScenario &s = synthCorpus[i];
+            synthSession(s.params, trace, presses);
+            labels.clear();
+            for (const SynthPress &press : presses)
+                labels.push_back({press.timeUs, press.side});
+            benchRun(trace, labels, s.mode, result);
+            benchPrint(s.name, s.mode, result, i == synthCorpusSize - 1);
+        }
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
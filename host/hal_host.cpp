@@ -0,0 +1,404 @@
+//
+//  Hardware abstraction: Linux host implementation
+//
+
+#include <string.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include "hal_host.h"
+
+// Periodic timer and tasks, run in deadline order while the clock advances
+struct HostPeriodic
+{
+    uint64_t nextUs;
+    uint32_t periodUs;
+    void (*fn)();
+};
+const int hostPeriodicMax = 8;
+
+static uint64_t hostNowUs = 0;
+static HostPeriodic hostPeriodic[hostPeriodicMax];
+static int hostPeriodicNum = 0;
+
+static const AdcSample *hostTrace = NULL;
+static size_t hostTraceCount = 0;
+static size_t hostTracePos = 0;
+
+static bool hostButtonIsDown[halButtonCount];
+static void (*hostButtonEdge)(int button, bool isDown) = NULL;
+static uint8_t hostEeprom[256];
+static uint8_t hostFlash[2 * 4096]; // Two 4KB sectors, like a small data partition
+static uint32_t hostFlashSector = 4096;
+static bool isHostFlashErased = false;
+static int hostFlashOpsLeft = -1;   // Writes / erases before the power cut, -1: no cut
+static bool isHostFlashTorn = false; // The cut operation is half done
+
+// Serial TX: a buffer drained at the baud rate on the virtual clock
+const uint32_t hostSerialTxBuffer = 1024;
+static FILE *hostSerialFile = NULL;
+static uint32_t hostSerialBytesPerSec = 11520;
+static uint64_t hostSerialIdleUs = 0; // Time the TX buffer runs empty
+
+// Datagram link: in flight to the device by arrival time, and the node side's handler
+static std::multimap<uint64_t, std::vector<uint8_t>> hostLinkInFlight;
+static void (*hostLinkNode)(const uint8_t *data, uint32_t len) = NULL;
+
+static std::string hostStorageRoot; // Directory standing in for the SD card, empty: no card
+static uint32_t hostEpochBase = 0;  // Epoch seconds at virtual time 0, 0: not set
+
+void hostTraceSet(const AdcSample *samples, size_t count)
+{
+    hostTrace = samples;
+    hostTraceCount = count;
+    hostTracePos = 0;
+    hostNowUs = count > 0 ? samples[0].timeUs : 0;
+    hostPeriodicNum = 0;
+}
+
+bool hostTraceDone()
+{
+    return hostTraceCount == 0 || hostNowUs > hostTrace[hostTraceCount - 1].timeUs;
+}
+
+void hostAdvanceUs(uint32_t us)
+{
+    uint64_t target = hostNowUs + us;
+
+    for (;;)
+    {
+        HostPeriodic *due = NULL;
+        for (int i = 0; i < hostPeriodicNum; i++)
+        {
+            if (hostPeriodic[i].nextUs <= target && (due == NULL || hostPeriodic[i].nextUs < due->nextUs))
+                due = &hostPeriodic[i];
+        }
+        if (due == NULL)
+            break;
+        hostNowUs = due->nextUs;
+        due->nextUs += due->periodUs;
+        due->fn();
+    }
+    hostNowUs = target;
+}
+
+// What the GPIO interrupt sees on the device
+void hostButtonSet(int button, bool isDown)
+{
+    if (hostButtonIsDown[button] == isDown)
+        return;
+    hostButtonIsDown[button] = isDown;
+    if (hostButtonEdge != NULL)
+        hostButtonEdge(button, isDown);
+}
+
+void halBegin()
+{
+}
+
+uint32_t halMicros()
+{
+    return (uint32_t)hostNowUs;
+}
+
+uint32_t halMillis()
+{
+    return (uint32_t)(hostNowUs / 1000);
+}
+
+void halDelay(uint32_t ms)
+{
+    hostAdvanceUs(ms * 1000);
+}
+
+bool halSleepUs(uint32_t us)
+{
+    hostAdvanceUs(us);
+    return false; // Nothing runs concurrently to wake it
+}
+
+void halWake()
+{
+}
+
+void halAdcBegin(const uint16_t *pins, int count)
+{
+}
+
+// Sample-and-hold over the trace. The cursor only moves forward.
+uint16_t halAdcRead(int ch)
+{
+    if (hostTraceCount == 0)
+        return 4095;
+    while (hostTracePos + 1 < hostTraceCount && hostTrace[hostTracePos + 1].timeUs <= hostNowUs)
+        hostTracePos++;
+    return hostTrace[hostTracePos].value[ch];
+}
+
+static void hostPeriodicAdd(uint32_t periodUs, void (*fn)())
+{
+    if (hostPeriodicNum >= hostPeriodicMax)
+        return;
+    hostPeriodic[hostPeriodicNum++] = {hostNowUs + periodUs, periodUs, fn};
+}
+
+void halTimerStartPeriodic(uint32_t periodUs, void (*callback)())
+{
+    hostPeriodicAdd(periodUs, callback);
+}
+
+// Tasks are run on the virtual clock like timers. Single threaded, core is ignored.
+void halTaskStartPeriodic(const char *name, void (*fn)(), uint32_t periodMs, int core)
+{
+    hostPeriodicAdd(periodMs * 1000, fn);
+}
+
+uint32_t halTaskStackFree(const char *name)
+{
+    return 0;
+}
+
+// Real (not virtual) time in ns, to profile the code running on the host
+uint32_t halCycleCount()
+{
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t halCyclesPerUs()
+{
+    return 1000;
+}
+
+// fp: where the bytes written go (NULL: discarded), baud: 10 bits per byte
+void hostSerialCapture(FILE *fp, uint32_t baud)
+{
+    hostSerialFile = fp;
+    hostSerialBytesPerSec = baud / 10;
+    hostSerialIdleUs = hostNowUs;
+}
+
+uint32_t halSerialWritable()
+{
+    uint64_t busyUs = hostSerialIdleUs > hostNowUs ? hostSerialIdleUs - hostNowUs : 0;
+    uint64_t queued = busyUs * hostSerialBytesPerSec / 1000000;
+
+    return queued < hostSerialTxBuffer ? hostSerialTxBuffer - queued : 0;
+}
+
+void halSerialWrite(const uint8_t *data, uint32_t len)
+{
+    if (hostSerialFile != NULL)
+        fwrite(data, 1, len, hostSerialFile);
+    if (hostSerialIdleUs < hostNowUs)
+        hostSerialIdleUs = hostNowUs;
+    hostSerialIdleUs += (uint64_t)len * 1000000 / hostSerialBytesPerSec;
+}
+
+void halSpeakerBegin()
+{
+}
+
+void halSpeakerTone(uint16_t freqHz)
+{
+}
+
+void halSpeakerMute()
+{
+}
+
+void halSpeakerSetVolume(uint8_t volume)
+{
+}
+
+void halButtonsBegin(void (*onEdge)(int button, bool isDown))
+{
+    hostButtonEdge = onEdge;
+}
+
+bool halButtonDown(int button)
+{
+    return hostButtonIsDown[button];
+}
+
+void hostLinkSet(void (*toNode)(const uint8_t *data, uint32_t len))
+{
+    hostLinkNode = toNode;
+    hostLinkInFlight.clear();
+}
+
+void hostLinkDeliver(const uint8_t *data, uint32_t len, uint32_t delayUs)
+{
+    hostLinkInFlight.emplace(hostNowUs + delayUs, std::vector<uint8_t>(data, data + len));
+}
+
+bool halLinkBegin(const char *ssid, const char *password, uint16_t port)
+{
+    return true;
+}
+
+bool halLinkSend(const uint8_t *data, uint32_t len)
+{
+    if (hostLinkNode != NULL)
+        hostLinkNode(data, len);
+    return true;
+}
+
+// Same arrival time: in the order delivered
+uint32_t halLinkReceive(uint8_t *buf, uint32_t size)
+{
+    auto first = hostLinkInFlight.begin();
+    uint32_t len;
+
+    if (first == hostLinkInFlight.end() || first->first > hostNowUs)
+        return 0;
+    len = first->second.size() < size ? first->second.size() : size;
+    memcpy(buf, first->second.data(), len);
+    hostLinkInFlight.erase(first);
+    return len;
+}
+
+void hostStorageSet(const char *dir)
+{
+    hostStorageRoot = dir != NULL ? dir : "";
+}
+
+bool halStorageBegin(const char *dir)
+{
+    if (hostStorageRoot.empty())
+        return false;
+    mkdir(hostStorageRoot.c_str(), 0777);
+    mkdir((hostStorageRoot + dir).c_str(), 0777);
+    return true;
+}
+
+uint32_t halFileSize(const char *path)
+{
+    struct stat st;
+
+    return stat((hostStorageRoot + path).c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+bool halFileRead(const char *path, uint32_t offset, void *buf, uint32_t len)
+{
+    FILE *fp = fopen((hostStorageRoot + path).c_str(), "rb");
+    bool isOk;
+
+    if (fp == NULL)
+        return false;
+    isOk = fseek(fp, offset, SEEK_SET) == 0 && fread(buf, 1, len, fp) == len;
+    fclose(fp);
+    return isOk;
+}
+
+bool halFileWrite(const char *path, uint32_t offset, const void *data, uint32_t len)
+{
+    std::string full = hostStorageRoot + path;
+    FILE *fp = fopen(full.c_str(), "r+b");
+    bool isOk;
+
+    if (fp == NULL)
+        fp = fopen(full.c_str(), "w+b");
+    if (fp == NULL)
+        return false;
+    isOk = fseek(fp, offset, SEEK_SET) == 0 && fwrite(data, 1, len, fp) == len;
+    return fclose(fp) == 0 && isOk;
+}
+
+uint32_t halEpochSeconds()
+{
+    return hostEpochBase != 0 ? hostEpochBase + (uint32_t)(hostNowUs / 1000000) : 0;
+}
+
+void halSetEpochSeconds(uint32_t sec)
+{
+    hostEpochBase = sec - (uint32_t)(hostNowUs / 1000000);
+}
+
+uint32_t halFlashBegin(uint32_t &sectorSize)
+{
+    if (!isHostFlashErased)
+        memset(hostFlash, 0xff, sizeof(hostFlash));
+    isHostFlashErased = true;
+    sectorSize = hostFlashSector;
+    return 2 * hostFlashSector;
+}
+
+void hostFlashLayout(uint32_t sectorSize)
+{
+    hostFlashSector = sectorSize * 2 <= sizeof(hostFlash) ? sectorSize : sizeof(hostFlash) / 2;
+    isHostFlashErased = false;
+}
+
+bool halFlashRead(uint32_t offset, void *buf, uint32_t len)
+{
+    if (offset + len > 2 * hostFlashSector)
+        return false;
+    memcpy(buf, hostFlash + offset, len);
+    return true;
+}
+
+// Power cut: the operation doesn't happen (torn: its first half does) and the
+// rest of the session fails. Returns the bytes the operation gets done.
+static uint32_t hostFlashPowered(uint32_t len)
+{
+    uint32_t done = len;
+
+    if (hostFlashOpsLeft == 0)
+        done = isHostFlashTorn ? len / 2 : 0;
+    else if (hostFlashOpsLeft > 0)
+        hostFlashOpsLeft--;
+    if (done < len)
+        isHostFlashTorn = false; // Power is off, nothing more gets done
+    return done;
+}
+
+void hostFlashCut(int ops, bool isTorn)
+{
+    hostFlashOpsLeft = ops;
+    isHostFlashTorn = isTorn;
+}
+
+bool halFlashWrite(uint32_t offset, const void *buf, uint32_t len)
+{
+    uint32_t done;
+
+    if (offset + len > 2 * hostFlashSector)
+        return false;
+    done = hostFlashPowered(len);
+    for (uint32_t i = 0; i < done; i++)
+        hostFlash[offset + i] &= ((const uint8_t *)buf)[i]; // Flash can only clear bits
+    return done == len;
+}
+
+bool halFlashErase(uint32_t offset, uint32_t len)
+{
+    uint32_t done;
+
+    if (offset + len > 2 * hostFlashSector)
+        return false;
+    done = hostFlashPowered(len);
+    memset(hostFlash + offset, 0xff, done);
+    return done == len;
+}
+
+void halEepromBegin(int size)
+{
+    memset(hostEeprom, 0xff, sizeof(hostEeprom));
+}
+
+uint8_t halEepromRead(int addr)
+{
+    return hostEeprom[addr];
+}
+
+void halEepromWrite(int addr, uint8_t value)
+{
+    hostEeprom[addr] = value;
+}
+
+void halEepromCommit()
+{
+}
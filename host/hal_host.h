@@ -0,0 +1,29 @@
+//
+//  Hardware abstraction: Linux host implementation
+//    The clock is virtual. halDelay() advances it and fires the periodic timer
+//    for every period that elapses, so a session replays as fast as the CPU allows.
+//    halAdcRead() returns the trace sample at the current virtual time.
+//    The sensor link is a loopback on the same clock (hostLinkSet()).
+//
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+#include "hal.h"
+#include "sampler.h"
+
+void hostTraceSet(const AdcSample *samples, size_t count);
+bool hostTraceDone();
+void hostAdvanceUs(uint32_t us);
+void hostButtonSet(int button, bool isDown); // Calls the halButtonsBegin() handler
+void hostSerialCapture(FILE *fp, uint32_t baud);
+void hostStorageSet(const char *dir); // SD card contents, NULL: no card
+// Settings flash: two sectors of sectorSize (4KB, the most), erased
+void hostFlashLayout(uint32_t sectorSize);
+// Settings flash loses power after ops more writes / erases (-1: never), it keeps its
+// contents. isTorn: the operation the power goes in gets its first half done.
+void hostFlashCut(int ops, bool isTorn);
+// Link to the sensor node, an in-process loopback: toNode gets what the device
+// sends, hostLinkDeliver() hands the device a datagram delayUs from now.
+void hostLinkSet(void (*toNode)(const uint8_t *data, uint32_t len));
+void hostLinkDeliver(const uint8_t *data, uint32_t len, uint32_t delayUs);
@@ -0,0 +1,119 @@
+//
+//  histdump: print the workout history of an SD card (history.h)
+//    Days come from the index; -s lists every session from the log, -r every rep.
+//    Records with a bad check byte (torn writes) are counted and skipped.
+//
+//  usage: histdump [-s] [-r] sd_root    (the directory holding history/)
+//
+
+#include <stdio.h>
+#include <string>
+#include <unistd.h>
+#include "history.h"
+
+static void printDate(uint16_t day)
+{
+    int year, month, mday;
+
+    if (day == 0)
+    {
+        printf("(no date) ");
+        return;
+    }
+    historyDate(day, year, month, mday);
+    printf("%04d-%02d-%02d", year, month, mday);
+}
+
+static bool dumpDays(const std::string &root)
+{
+    FILE *fp = fopen((root + "/history/days.bin").c_str(), "rb");
+    HistoryDay d;
+
+    if (fp == NULL)
+        return false;
+    printf("day         sessions  reps  active min  log sector\n");
+    while (fread(&d, sizeof(d), 1, fp) == 1)
+    {
+        printDate(d.day);
+        printf("  %8u %5u %11u %11u\n", d.sessions, d.reps, d.activeSec / 60, d.firstSector);
+    }
+    fclose(fp);
+    return true;
+}
+
+static bool dumpLog(const std::string &root, bool isReps)
+{
+    FILE *fp = fopen((root + "/history/log.bin").c_str(), "rb");
+    HistoryRecord rec;
+    uint32_t bad = 0;
+
+    if (fp == NULL)
+        return false;
+    while (fread(&rec, sizeof(rec), 1, fp) == 1)
+    {
+        if (rec.type == historyEmpty)
+            continue;
+        if (rec.check != historyCheck(rec))
+        {
+            bad++;
+            continue;
+        }
+        switch (rec.type)
+        {
+        case historySessionStart:
+            printf("\nsession at sector %u: ", rec.value);
+            printDate(rec.time / 86400);
+            if (rec.time != 0)
+                printf(" %02u:%02u UTC", rec.time / 3600 % 24, rec.time / 60 % 60);
+            printf(", %u x %u, mode %u\n", rec.count, rec.extra, rec.side);
+            break;
+        case historyRep:
+            if (isReps)
+                printf("  set %u rep %2u at %8.3f s (%c) interval %u ms\n", rec.set, rec.count,
+                       rec.time / 1e3, rec.side ? 'L' : 'R', rec.value);
+            break;
+        case historySetEnd:
+            printf("  set %u: %u reps, interval %u ms, at %.1f s\n", rec.set, rec.count, rec.extra,
+                   rec.value / 1e3);
+            break;
+        case historySessionEnd:
+            printf("  %s after %u sets: %u reps in %.1f min\n", rec.side ? "aborted" : "finished",
+                   rec.set, rec.count, rec.value / 60e3);
+            break;
+        default:
+            bad++;
+            break;
+        }
+    }
+    fclose(fp);
+    if (bad != 0)
+        printf("%u bad records skipped\n", bad);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    bool isSessions = false;
+    bool isReps = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "sr")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': isSessions = true; break;
+        case 'r': isSessions = isReps = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-s] [-r] sd_root\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc || !dumpDays(argv[optind]))
+    {
+        fprintf(stderr, "no history under %s\n", optind < argc ? argv[optind] : "?");
+        return 1;
+    }
+    if (isSessions && !dumpLog(argv[optind], isReps))
+        return 1;
+    return 0;
+}
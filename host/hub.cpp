@@ -0,0 +1,658 @@
+//
+//  hub: gym hub, collects the sessions of many units over TCP and UDP (hub_protocol.h)
+//    The main thread runs the event loop (epoll): it accepts units, cuts the TCP
+//    streams into frames, reads UDP datagrams and hands each record to the
+//    worker owning its unit (unit % workers), so the live state of a unit is
+//    only touched by one thread and needs no lock. Workers pass the acks back
+//    to the loop, which owns every socket.
+//    Finished sessions go to the store thread. It folds them into per unit / day
+//    totals and rewrites the aggregate file once per interval: one write and
+//    fsync for the whole batch, however many units finished.
+//
+//  usage: hub [-p port] [-j workers] [-o aggregates.csv] [-i store interval ms]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "spsc_queue.h"
+#include "telemetry.h"
+#include "hub_protocol.h"
+
+const uint16_t hubQueueSize = 4096;         // Records / acks between the loop and a worker
+const size_t hubOutMax = 64 * 1024;         // Acks held for a unit that doesn't read them
+const int hubStatsInterval = 5;             // Status line period: 5s
+const uint64_t hubIdListen = 0;             // epoll ids, connections from hubIdFirstConn
+const uint64_t hubIdUdp = 1;
+const uint64_t hubIdAcks = 2;
+const uint64_t hubIdFirstConn = 16;
+
+struct HubJob
+{
+    uint64_t conn; // hubIdUdp: reply to from
+    sockaddr_in from;
+    HubMessage msg;
+};
+
+struct HubAck
+{
+    uint64_t conn;
+    sockaddr_in from;
+    uint8_t type; // hubMsgAck / hubMsgAckDuplicate
+    uint32_t unit;
+    uint32_t boot;
+    uint32_t sequence;
+};
+
+// Live state of a unit, owned by its worker
+struct HubUnit
+{
+    bool isSeen;
+    bool isActive;       // In a session
+    uint32_t boot;       // Boot id of the unit's sequence
+    uint32_t sequence;   // Last record applied
+    uint32_t sessionEpoch;
+    uint16_t sets;
+    uint16_t repsPerSet;
+    uint8_t set;
+    uint16_t rep;
+    uint32_t sessionReps;
+    uint32_t sessions;   // Finished since the hub started
+};
+
+// Sessions of a unit on a day, the persisted aggregate
+struct HubTotal
+{
+    uint32_t unit;
+    uint16_t day;
+    uint32_t sessions;
+    uint32_t reps;
+    uint32_t activeSec;
+};
+
+struct HubWorker
+{
+    SpscQueue<HubJob, hubQueueSize> jobs; // Loop -> worker
+    SpscQueue<HubAck, hubQueueSize> acks; // Worker -> loop
+    int wake;                             // eventfd, jobs queued
+    bool isPending;                       // Loop side: jobs pushed since the last wake
+    std::unordered_map<uint32_t, HubUnit> units;
+    std::atomic<uint32_t> unitCount{0};
+    std::atomic<uint32_t> activeCount{0};
+    std::atomic<uint32_t> records{0};
+    std::atomic<uint32_t> duplicates{0};
+    std::atomic<uint32_t> lost{0};
+    std::atomic<uint32_t> restarts{0};
+    std::thread thread;
+};
+
+struct HubConn
+{
+    int fd;
+    std::vector<uint8_t> frame; // Bytes since the last delimiter
+    bool isOverlong;
+    std::vector<uint8_t> out;   // Ack frames not sent yet
+    bool isWaitingOut;          // EPOLLOUT on
+    bool isTouched;
+};
+
+static std::atomic<bool> isHubRunning(true);
+static int hubEpoll;
+static int hubUdp;
+static int hubAckWake; // eventfd, acks queued
+static std::vector<std::unique_ptr<HubWorker>> hubWorkers;
+static std::unordered_map<uint64_t, HubConn> hubConns;
+static uint64_t hubNextConn = hubIdFirstConn;
+static uint32_t hubBadFrames;
+static uint32_t hubAckDrops;
+
+// Store thread input, and its totals
+static std::mutex hubStoreLock;
+static std::vector<HubTotal> hubStoreQueue;
+static std::map<std::pair<uint32_t, uint16_t>, HubTotal> hubTotals;
+static std::atomic<uint32_t> hubStoredSessions(0);
+static std::atomic<uint32_t> hubStoreWrites(0);
+
+static void hubStop(int)
+{
+    isHubRunning = false;
+}
+
+//---- Workers
+
+// False: had it already
+static bool hubApply(HubWorker &w, const HubMessage &msg, std::vector<HubTotal> &done)
+{
+    const HistoryRecord &rec = msg.record;
+    HubUnit &u = w.units[msg.unit];
+    int32_t gap = msg.sequence - u.sequence;
+
+    if (!u.isSeen)
+    {
+        u.isSeen = true;
+        w.unitCount++;
+    }
+    else if (msg.boot != u.boot)
+    {
+        // The unit restarted, and its sequence with it. A session it was in is gone.
+        w.restarts++;
+        if (u.isActive)
+            w.activeCount--;
+        u.isActive = false;
+    }
+    else if (gap <= 0)
+    {
+        w.duplicates++; // Resent over UDP, acked again
+        return false;
+    }
+    else if (gap > 1)
+        w.lost += gap - 1;
+    u.boot = msg.boot;
+    u.sequence = msg.sequence;
+    w.records++;
+
+    switch (rec.type)
+    {
+    case historySessionStart:
+        if (!u.isActive)
+            w.activeCount++;
+        u.isActive = true;
+        u.sessionEpoch = rec.time;
+        u.sets = rec.count;
+        u.repsPerSet = rec.extra;
+        u.set = 0;
+        u.rep = 0;
+        u.sessionReps = 0;
+        break;
+    case historyRep:
+        u.set = rec.set;
+        u.rep = rec.count;
+        u.sessionReps++;
+        break;
+    case historySetEnd:
+        u.set = rec.set;
+        break;
+    case historySessionEnd:
+        if (u.isActive)
+            w.activeCount--;
+        u.isActive = false;
+        u.sessions++;
+        done.push_back(HubTotal{msg.unit, (uint16_t)(u.sessionEpoch / 86400), 1, rec.count,
+                                rec.value / 1000});
+        break;
+    }
+    return true;
+}
+
+static void hubWork(HubWorker *w)
+{
+    std::vector<HubTotal> done;
+    HubJob job;
+    uint64_t n = 1;
+
+    while (isHubRunning)
+    {
+        bool isAcked = false;
+
+        while (w->jobs.pop(job))
+        {
+            uint8_t type = hubApply(*w, job.msg, done) ? hubMsgAck : hubMsgAckDuplicate;
+            w->acks.push(HubAck{job.conn, job.from, type, job.msg.unit, job.msg.boot, job.msg.sequence});
+            isAcked = true;
+        }
+        if (isAcked && write(hubAckWake, &n, sizeof(n)) < 0)
+            perror("ack wake");
+        if (!done.empty())
+        {
+            std::lock_guard<std::mutex> guard(hubStoreLock);
+            hubStoreQueue.insert(hubStoreQueue.end(), done.begin(), done.end());
+            done.clear();
+        }
+        if (read(w->wake, &n, sizeof(n)) < 0 && errno != EINTR)
+            break;
+        n = 1;
+    }
+}
+
+//---- Store
+
+static void hubLoadTotals(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    char line[128];
+    HubTotal t;
+    unsigned day;
+
+    if (fp == NULL)
+        return;
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (sscanf(line, "%u,%u,%*[^,],%u,%u,%u", &t.unit, &day, &t.sessions, &t.reps, &t.activeSec) != 5)
+            continue; // Header
+        t.day = day;
+        hubTotals[std::make_pair(t.unit, t.day)] = t;
+    }
+    fclose(fp);
+}
+
+// Fold the queued sessions in and replace the file: written to a temporary, then renamed
+static void hubStoreBatch(const std::string &path)
+{
+    std::vector<HubTotal> batch;
+    std::string tmp = path + ".tmp";
+    FILE *fp;
+    int year, month, mday;
+
+    {
+        std::lock_guard<std::mutex> guard(hubStoreLock);
+        batch.swap(hubStoreQueue);
+    }
+    if (batch.empty())
+        return;
+    for (const HubTotal &s : batch)
+    {
+        HubTotal &t = hubTotals[std::make_pair(s.unit, s.day)];
+        t.unit = s.unit;
+        t.day = s.day;
+        t.sessions += s.sessions;
+        t.reps += s.reps;
+        t.activeSec += s.activeSec;
+    }
+
+    fp = fopen(tmp.c_str(), "w");
+    if (fp == NULL)
+    {
+        perror(tmp.c_str());
+        return; // Kept in hubTotals, written with the next batch
+    }
+    fprintf(fp, "unit,day,date,sessions,reps,active_sec\n");
+    for (const auto &entry : hubTotals)
+    {
+        const HubTotal &t = entry.second;
+        historyDate(t.day, year, month, mday);
+        fprintf(fp, "%u,%u,%04d-%02d-%02d,%u,%u,%u\n", t.unit, t.day, year, month, mday, t.sessions,
+                t.reps, t.activeSec);
+    }
+    if (fflush(fp) != 0 || fsync(fileno(fp)) != 0)
+        perror(tmp.c_str());
+    fclose(fp);
+    if (rename(tmp.c_str(), path.c_str()) != 0)
+        perror(path.c_str());
+    hubStoredSessions += batch.size();
+    hubStoreWrites++;
+}
+
+static void hubStore(std::string path, int intervalMs)
+{
+    auto next = std::chrono::steady_clock::now();
+
+    while (isHubRunning)
+    {
+        next += std::chrono::milliseconds(intervalMs);
+        while (isHubRunning && std::chrono::steady_clock::now() < next)
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        hubStoreBatch(path);
+    }
+    hubStoreBatch(path); // What the workers handed over before stopping
+}
+
+//---- Event loop
+
+static void hubWatch(int fd, uint64_t id, uint32_t events, int op)
+{
+    epoll_event ev = {};
+
+    ev.events = events;
+    ev.data.u64 = id;
+    if (epoll_ctl(hubEpoll, op, fd, &ev) != 0)
+        perror("epoll_ctl");
+}
+
+static void hubDispatch(uint64_t conn, const sockaddr_in &from, const uint8_t *packet, size_t len)
+{
+    HubJob job;
+    HubWorker *w;
+
+    if (!hubUnpack(packet, len, job.msg) || job.msg.type != hubMsgRecord)
+    {
+        hubBadFrames++;
+        return;
+    }
+    job.conn = conn;
+    job.from = from;
+    w = hubWorkers[job.msg.unit % hubWorkers.size()].get();
+    if (w->jobs.push(job)) // Full: dropped and counted, the unit sees no ack
+        w->isPending = true;
+}
+
+static void hubAccept(int listener)
+{
+    sockaddr_in from;
+    socklen_t len = sizeof(from);
+    int one = 1;
+    int fd;
+
+    while ((fd = accept4(listener, (sockaddr *)&from, &len, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        HubConn &c = hubConns[hubNextConn];
+        c.fd = fd;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        hubWatch(fd, hubNextConn++, EPOLLIN, EPOLL_CTL_ADD);
+        len = sizeof(from);
+    }
+}
+
+static void hubClose(uint64_t id)
+{
+    auto it = hubConns.find(id);
+
+    if (it == hubConns.end())
+        return;
+    epoll_ctl(hubEpoll, EPOLL_CTL_DEL, it->second.fd, NULL);
+    close(it->second.fd);
+    hubConns.erase(it); // Acks still queued for it are dropped
+}
+
+// False: closed by the unit, or failed
+static bool hubRead(uint64_t id, HubConn &c)
+{
+    static const sockaddr_in noAddr = {};
+    uint8_t buf[4096];
+    uint8_t packet[hubFrameMax];
+    ssize_t n;
+
+    for (;;)
+    {
+        n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n == 0)
+            return false;
+        if (n < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (buf[i] != 0)
+            {
+                if (c.frame.size() < hubFrameMax)
+                    c.frame.push_back(buf[i]);
+                else
+                    c.isOverlong = true;
+                continue;
+            }
+            if (c.isOverlong)
+                hubBadFrames++;
+            else if (!c.frame.empty())
+                hubDispatch(id, noAddr, packet, cobsDecode(c.frame.data(), c.frame.size(), packet));
+            c.frame.clear();
+            c.isOverlong = false;
+        }
+    }
+}
+
+static void hubReadUdp()
+{
+    uint8_t packet[2048];
+    sockaddr_in from;
+    socklen_t len;
+    ssize_t n;
+
+    // Bounded, so a flood of datagrams doesn't starve the TCP units
+    for (int i = 0; i < 256; i++)
+    {
+        len = sizeof(from);
+        n = recvfrom(hubUdp, packet, sizeof(packet), 0, (sockaddr *)&from, &len);
+        if (n < 0)
+            return;
+        hubDispatch(hubIdUdp, from, packet, n);
+    }
+}
+
+static bool hubFlush(uint64_t id, HubConn &c)
+{
+    bool isWaiting;
+
+    while (!c.out.empty())
+    {
+        ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        c.out.erase(c.out.begin(), c.out.begin() + n);
+    }
+    isWaiting = !c.out.empty();
+    if (isWaiting != c.isWaitingOut)
+    {
+        hubWatch(c.fd, id, EPOLLIN | (isWaiting ? (uint32_t)EPOLLOUT : 0), EPOLL_CTL_MOD);
+        c.isWaitingOut = isWaiting;
+    }
+    return true;
+}
+
+// Collect the acks of all workers, one send per connection
+static void hubSendAcks()
+{
+    std::vector<uint64_t> touched;
+    std::vector<uint64_t> failed;
+    uint8_t buf[hubFrameMax];
+    uint64_t n;
+    HubAck ack;
+
+    if (read(hubAckWake, &n, sizeof(n)) < 0 && errno != EAGAIN)
+        perror("ack wake");
+    for (auto &w : hubWorkers)
+    {
+        while (w->acks.pop(ack))
+        {
+            HubMessage msg = {ack.type, ack.unit, ack.boot, ack.sequence, {}};
+
+            if (ack.conn == hubIdUdp)
+            {
+                sendto(hubUdp, buf, hubPack(msg, buf), 0, (const sockaddr *)&ack.from, sizeof(ack.from));
+                continue;
+            }
+            auto it = hubConns.find(ack.conn);
+            if (it == hubConns.end())
+                continue; // Unit left
+            HubConn &c = it->second;
+            size_t len = hubFrame(msg, buf);
+            if (c.out.size() + len > hubOutMax)
+            {
+                hubAckDrops++;
+                continue;
+            }
+            c.out.insert(c.out.end(), buf, buf + len);
+            if (!c.isTouched)
+            {
+                c.isTouched = true;
+                touched.push_back(ack.conn);
+            }
+        }
+    }
+    for (uint64_t id : touched)
+    {
+        HubConn &c = hubConns[id];
+        c.isTouched = false;
+        if (!hubFlush(id, c))
+            failed.push_back(id);
+    }
+    for (uint64_t id : failed)
+        hubClose(id);
+}
+
+static void hubWakeWorkers()
+{
+    uint64_t n = 1;
+
+    for (auto &w : hubWorkers)
+    {
+        if (w->isPending && write(w->wake, &n, sizeof(n)) < 0)
+            perror("worker wake");
+        w->isPending = false;
+    }
+}
+
+static void hubPrintStats(double sec, uint32_t &lastRecords)
+{
+    uint32_t units = 0, active = 0, records = 0, duplicates = 0, lost = 0, restarts = 0, queueDrops = 0;
+
+    for (auto &w : hubWorkers)
+    {
+        units += w->unitCount;
+        active += w->activeCount;
+        records += w->records;
+        duplicates += w->duplicates;
+        lost += w->lost;
+        restarts += w->restarts;
+        queueDrops += w->jobs.dropped() + w->acks.dropped();
+    }
+    fprintf(stderr,
+            "%u units (%u in a session), %zu connections, %.0f records/s, %u duplicates, "
+            "%u lost, %u restarts, %u bad frames, %u queue drops, %u ack drops, %u sessions stored in %u writes\n",
+            units, active, hubConns.size(), (records - lastRecords) / sec, duplicates, lost, restarts,
+            hubBadFrames, queueDrops, hubAckDrops, hubStoredSessions.load(), hubStoreWrites.load());
+    lastRecords = records;
+}
+
+static int hubSocket(int type, uint16_t port)
+{
+    sockaddr_in addr = {};
+    int one = 1;
+    int fd = socket(AF_INET, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 || (type == SOCK_STREAM && listen(fd, 1024) != 0))
+    {
+        perror("hub socket");
+        exit(1);
+    }
+    return fd;
+}
+
+int main(int argc, char **argv)
+{
+    std::string storePath = "hub_totals.csv";
+    int port = hubPort;
+    int workerCount = std::thread::hardware_concurrency();
+    int storeInterval = 1000;
+    int listener;
+    epoll_event events[256];
+    uint32_t lastRecords = 0;
+    std::thread store;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:j:o:i:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p': port = atoi(optarg); break;
+        case 'j': workerCount = atoi(optarg); break;
+        case 'o': storePath = optarg; break;
+        case 'i': storeInterval = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-p port] [-j workers] [-o aggregates.csv] [-i store interval ms]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (workerCount < 1)
+        workerCount = 1;
+    if (storeInterval < 1)
+        storeInterval = 1;
+    signal(SIGINT, hubStop);
+    signal(SIGTERM, hubStop);
+    signal(SIGPIPE, SIG_IGN);
+
+    hubLoadTotals(storePath.c_str());
+    hubEpoll = epoll_create1(EPOLL_CLOEXEC);
+    listener = hubSocket(SOCK_STREAM, port);
+    hubUdp = hubSocket(SOCK_DGRAM, port);
+    hubAckWake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    hubWatch(listener, hubIdListen, EPOLLIN, EPOLL_CTL_ADD);
+    hubWatch(hubUdp, hubIdUdp, EPOLLIN, EPOLL_CTL_ADD);
+    hubWatch(hubAckWake, hubIdAcks, EPOLLIN, EPOLL_CTL_ADD);
+    for (int i = 0; i < workerCount; i++)
+    {
+        hubWorkers.emplace_back(new HubWorker());
+        hubWorkers.back()->wake = eventfd(0, EFD_CLOEXEC);
+        hubWorkers.back()->thread = std::thread(hubWork, hubWorkers.back().get());
+    }
+    fprintf(stderr, "hub on port %d (TCP, UDP), %d workers, totals in %s (%zu loaded)\n", port, workerCount,
+            storePath.c_str(), hubTotals.size());
+    store = std::thread(hubStore, storePath, storeInterval);
+
+    auto lastStats = std::chrono::steady_clock::now();
+    while (isHubRunning)
+    {
+        int n = epoll_wait(hubEpoll, events, 256, 1000);
+
+        for (int i = 0; i < n; i++)
+        {
+            uint64_t id = events[i].data.u64;
+            if (id == hubIdListen)
+                hubAccept(listener);
+            else if (id == hubIdUdp)
+                hubReadUdp();
+            else if (id == hubIdAcks)
+                hubSendAcks();
+            else
+            {
+                auto it = hubConns.find(id);
+                if (it == hubConns.end())
+                    continue; // Closed earlier in this batch
+                bool isOpen = true;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    isOpen = hubRead(id, it->second);
+                if (isOpen && (events[i].events & EPOLLOUT))
+                    isOpen = hubFlush(id, it->second);
+                if (!isOpen)
+                    hubClose(id);
+            }
+        }
+        hubWakeWorkers();
+
+        auto now = std::chrono::steady_clock::now();
+        double sec = std::chrono::duration<double>(now - lastStats).count();
+        if (sec >= hubStatsInterval)
+        {
+            hubPrintStats(sec, lastRecords);
+            lastStats = now;
+        }
+    }
+
+    for (auto &w : hubWorkers)
+    {
+        uint64_t n = 1;
+        if (write(w->wake, &n, sizeof(n)) < 0)
+            perror("worker wake");
+        w->thread.join();
+    }
+    store.join();
+    hubPrintStats(hubStatsInterval, lastRecords);
+    return 0;
+}
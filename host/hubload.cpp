@@ -0,0 +1,387 @@
+//
+//  hubload: load generator for the hub, hundreds of simulated units at once
+//    Every unit works out in a loop (sets x reps, rests in between) sped up by
+//    -x, and sends its records over its own TCP connection, or UDP socket with
+//    -u. The ack of each record gives its round trip latency; records without
+//    an ack by the end count as lost. Units are spread over -j threads, each
+//    with its own epoll loop.
+//    Every -r sessions a unit reboots: new boot id, sequence from 0 again. A
+//    record the hub acks as a duplicate was sent once only, so it counts as an error.
+//
+//  usage: hubload [-a address] [-p port] [-n units] [-b first unit id] [-d sec] [-x speedup]
+//                 [-j threads] [-r sessions per boot] [-u]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
+#include "telemetry.h"
+#include "hub_protocol.h"
+
+// Simulated workout, real time before the speedup
+const int loadSets = 3;
+const int loadReps = 10;
+const uint32_t loadRepMs = 2000;
+const uint32_t loadRestMs = 30000; // Between sets and between sessions
+const uint64_t loadGraceNs = 2000000000; // Wait for the last acks: 2s
+
+struct LoadSent
+{
+    uint32_t boot;
+    uint32_t sequence;
+    uint64_t ns; // Send time
+};
+
+struct LoadUnit
+{
+    uint32_t id;
+    int fd;
+    uint32_t boot;
+    uint32_t sequence;                                   // Last sent
+    std::deque<LoadSent> inFlight;
+    std::vector<uint8_t> frame;                          // Ack bytes since the last delimiter
+    uint64_t dueNs;                                      // Next record
+    uint64_t sessionNs;
+    uint64_t lastRepNs;
+    uint32_t sessions;
+    int set;                                             // 0: next record starts a session
+    int rep;
+};
+
+struct LoadStats
+{
+    uint64_t sent;
+    uint64_t acked;
+    uint64_t lost;
+    uint64_t failed;     // Sends refused
+    uint64_t duplicates; // Acked as resent
+    uint64_t reboots;
+    std::vector<uint32_t> latencyUs;
+};
+
+static sockaddr_in loadHub;
+static bool isLoadUdp = false;
+static double loadSpeedup = 100;
+static uint32_t loadSessionsPerBoot = 4;
+
+static uint64_t loadNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static uint64_t loadScaled(uint32_t ms, std::minstd_rand &rng)
+{
+    std::uniform_real_distribution<double> jitter(0.9, 1.1);
+    return ms * 1e6 * jitter(rng) / loadSpeedup;
+}
+
+static uint32_t loadSessionMs(const LoadUnit &u, uint64_t ns)
+{
+    return (ns - u.sessionNs) * loadSpeedup / 1e6;
+}
+
+// Next record of the unit's workout, and when the one after it is due
+static HistoryRecord loadNext(LoadUnit &u, uint64_t now, std::minstd_rand &rng, LoadStats &stats)
+{
+    HistoryRecord rec = {};
+
+    if (u.set == 0)
+    {
+        if (u.sessions > 0 && u.sessions % loadSessionsPerBoot == 0 && u.sequence > 0)
+        {
+            u.boot = rng();
+            u.sequence = 0;
+            stats.reboots++;
+        }
+        u.sessionNs = u.lastRepNs = now;
+        rec = HistoryRecord{historySessionStart, 0, 0, 0, (uint32_t)time(NULL), loadSets, loadReps, u.sessions};
+        u.set = 1;
+        u.rep = 0;
+        u.dueNs += loadScaled(loadRepMs, rng);
+    }
+    else if (u.rep < loadReps)
+    {
+        u.rep++;
+        rec = HistoryRecord{historyRep, (uint8_t)u.set, (uint8_t)(u.rep & 1), 0, loadSessionMs(u, now),
+                            (uint16_t)u.rep, 0, u.rep > 1 ? (uint32_t)((now - u.lastRepNs) * loadSpeedup / 1e6) : 0};
+        u.lastRepNs = now;
+        u.dueNs += u.rep < loadReps ? loadScaled(loadRepMs, rng) : 0;
+    }
+    else if (u.rep == loadReps)
+    {
+        rec = HistoryRecord{historySetEnd, (uint8_t)u.set, 0, 0, loadSessionMs(u, now), loadReps,
+                            (uint16_t)loadRepMs, loadSessionMs(u, now)};
+        u.rep++; // Set closed
+        u.dueNs += u.set < loadSets ? loadScaled(loadRestMs, rng) : 0;
+    }
+    if (rec.type == 0)
+    {
+        if (u.set < loadSets)
+        {
+            u.set++;
+            u.rep = 0;
+            return loadNext(u, now, rng, stats);
+        }
+        rec = HistoryRecord{historySessionEnd, loadSets, 0, 0, loadSessionMs(u, now),
+                            loadSets * loadReps, 0, loadSessionMs(u, now)};
+        u.sessions++;
+        u.set = 0;
+        u.dueNs += loadScaled(loadRestMs, rng);
+    }
+    rec.check = historyCheck(rec);
+    return rec;
+}
+
+static void loadSend(LoadUnit &u, const HistoryRecord &rec, uint64_t now, LoadStats &stats)
+{
+    HubMessage msg = {hubMsgRecord, u.id, u.boot, ++u.sequence, rec};
+    uint8_t buf[hubFrameMax];
+    size_t len = isLoadUdp ? hubPack(msg, buf) : hubFrame(msg, buf);
+
+    if (send(u.fd, buf, len, MSG_NOSIGNAL) != (ssize_t)len)
+    {
+        stats.failed++;
+        return;
+    }
+    u.inFlight.push_back(LoadSent{msg.boot, msg.sequence, now});
+    stats.sent++;
+}
+
+static void loadAck(LoadUnit &u, const uint8_t *packet, size_t len, LoadStats &stats)
+{
+    HubMessage msg;
+    uint64_t now = loadNowNs();
+
+    if (!hubUnpack(packet, len, msg) || msg.type == hubMsgRecord || msg.unit != u.id)
+        return;
+    auto sent = std::find_if(u.inFlight.begin(), u.inFlight.end(), [&](const LoadSent &s) {
+        return s.boot == msg.boot && s.sequence == msg.sequence;
+    });
+    if (sent == u.inFlight.end())
+        return;
+    // Acks come in order; older records still waiting were lost (UDP) or dropped
+    stats.lost += sent - u.inFlight.begin();
+    stats.latencyUs.push_back((now - sent->ns) / 1000);
+    stats.acked++;
+    if (msg.type == hubMsgAckDuplicate)
+        stats.duplicates++;
+    u.inFlight.erase(u.inFlight.begin(), sent + 1);
+}
+
+static void loadReceive(LoadUnit &u, LoadStats &stats)
+{
+    uint8_t buf[4096];
+    uint8_t packet[hubFrameMax];
+    ssize_t n;
+
+    while ((n = recv(u.fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+        if (isLoadUdp)
+        {
+            loadAck(u, buf, n, stats);
+            continue;
+        }
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (buf[i] != 0)
+            {
+                if (u.frame.size() < hubFrameMax)
+                    u.frame.push_back(buf[i]);
+                continue;
+            }
+            if (!u.frame.empty())
+                loadAck(u, packet, cobsDecode(u.frame.data(), u.frame.size(), packet), stats);
+            u.frame.clear();
+        }
+    }
+}
+
+static void loadRun(std::vector<LoadUnit> *units, uint64_t endNs, uint32_t seed, LoadStats *stats)
+{
+    int ep = epoll_create1(0);
+    epoll_event events[64];
+    std::minstd_rand rng(seed);
+    uint64_t now = loadNowNs();
+    size_t waiting;
+
+    for (size_t i = 0; i < units->size(); i++)
+    {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.u64 = i;
+        epoll_ctl(ep, EPOLL_CTL_ADD, (*units)[i].fd, &ev);
+        // Staggered, so the units don't all start a session together
+        (*units)[i].dueNs = now + loadScaled(std::uniform_int_distribution<uint32_t>(0, loadRestMs)(rng), rng);
+    }
+
+    while (now < endNs)
+    {
+        uint64_t next = endNs;
+        for (LoadUnit &u : *units)
+            next = std::min(next, u.dueNs);
+        int n = epoll_wait(ep, events, 64, next > now ? (next - now + 999999) / 1000000 : 0);
+        for (int i = 0; i < n; i++)
+            loadReceive((*units)[events[i].data.u64], *stats);
+        now = loadNowNs();
+        for (LoadUnit &u : *units)
+        {
+            while (u.dueNs <= now && now < endNs)
+                loadSend(u, loadNext(u, now, rng, *stats), now, *stats);
+        }
+    }
+
+    do
+    {
+        int n = epoll_wait(ep, events, 64, 100);
+        for (int i = 0; i < n; i++)
+            loadReceive((*units)[events[i].data.u64], *stats);
+        waiting = 0;
+        for (LoadUnit &u : *units)
+            waiting += u.inFlight.size();
+    } while (waiting > 0 && loadNowNs() < endNs + loadGraceNs);
+    stats->lost += waiting;
+    close(ep);
+}
+
+static int loadConnect()
+{
+    int fd = socket(AF_INET, isLoadUdp ? SOCK_DGRAM : SOCK_STREAM, 0);
+    int one = 1;
+
+    if (fd < 0 || connect(fd, (const sockaddr *)&loadHub, sizeof(loadHub)) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    if (!isLoadUdp)
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static uint32_t loadPercentile(const std::vector<uint32_t> &sorted, double q)
+{
+    return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, (size_t)(q * sorted.size()))];
+}
+
+int main(int argc, char **argv)
+{
+    const char *address = "127.0.0.1";
+    int port = hubPort;
+    int unitCount = 300;
+    uint32_t firstId = 1;
+    double duration = 10;
+    int threadCount = 2;
+    std::vector<std::vector<LoadUnit>> groups;
+    std::vector<LoadStats> stats;
+    std::vector<std::thread> threads;
+    LoadStats total = {};
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:p:n:b:d:x:j:r:u")) != -1)
+    {
+        switch (opt)
+        {
+        case 'a': address = optarg; break;
+        case 'p': port = atoi(optarg); break;
+        case 'n': unitCount = atoi(optarg); break;
+        case 'b': firstId = strtoul(optarg, NULL, 0); break;
+        case 'd': duration = atof(optarg); break;
+        case 'x': loadSpeedup = atof(optarg); break;
+        case 'j': threadCount = atoi(optarg); break;
+        case 'r': loadSessionsPerBoot = atoi(optarg); break;
+        case 'u': isLoadUdp = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-a address] [-p port] [-n units] [-b first unit id] [-d sec] "
+                            "[-x speedup] [-j threads] [-r sessions per boot] [-u]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (threadCount < 1)
+        threadCount = 1;
+    if (loadSpeedup <= 0)
+        loadSpeedup = 1;
+    if (loadSessionsPerBoot < 1)
+        loadSessionsPerBoot = 1;
+    loadHub.sin_family = AF_INET;
+    loadHub.sin_port = htons(port);
+    if (inet_pton(AF_INET, address, &loadHub.sin_addr) != 1)
+    {
+        fprintf(stderr, "bad address %s\n", address);
+        return 1;
+    }
+
+    groups.resize(threadCount);
+    stats.resize(threadCount);
+    std::random_device seed;
+    for (int i = 0; i < unitCount; i++)
+    {
+        LoadUnit u = {};
+        u.id = firstId + i;
+        u.boot = seed();
+        u.fd = loadConnect();
+        if (u.fd < 0)
+        {
+            perror("connect");
+            return 1;
+        }
+        groups[i % threadCount].push_back(u);
+    }
+
+    uint64_t start = loadNowNs();
+    uint64_t endNs = start + (uint64_t)(duration * 1e9);
+    for (int t = 0; t < threadCount; t++)
+        threads.emplace_back(loadRun, &groups[t], endNs, 1 + t, &stats[t]);
+    for (std::thread &thread : threads)
+        thread.join();
+
+    for (const LoadStats &s : stats)
+    {
+        total.sent += s.sent;
+        total.acked += s.acked;
+        total.lost += s.lost;
+        total.failed += s.failed;
+        total.duplicates += s.duplicates;
+        total.reboots += s.reboots;
+        total.latencyUs.insert(total.latencyUs.end(), s.latencyUs.begin(), s.latencyUs.end());
+    }
+    std::sort(total.latencyUs.begin(), total.latencyUs.end());
+    double mean = 0;
+    for (uint32_t us : total.latencyUs)
+        mean += us;
+    mean = total.latencyUs.empty() ? 0 : mean / total.latencyUs.size();
+
+    printf("%d units over %s, %.1f s at %gx, %d threads\n", unitCount, isLoadUdp ? "UDP" : "TCP", duration,
+           loadSpeedup, threadCount);
+    printf("sent %llu records, acked %llu, lost %llu, send failures %llu\n", (unsigned long long)total.sent,
+           (unsigned long long)total.acked, (unsigned long long)total.lost, (unsigned long long)total.failed);
+    printf("%llu reboots, %llu records taken for duplicates\n", (unsigned long long)total.reboots,
+           (unsigned long long)total.duplicates);
+    printf("throughput %.0f records/s\n", total.acked / duration);
+    printf("ack latency us: mean %.0f p50 %u p90 %u p99 %u p99.9 %u max %u\n", mean,
+           loadPercentile(total.latencyUs, 0.5), loadPercentile(total.latencyUs, 0.9),
+           loadPercentile(total.latencyUs, 0.99), loadPercentile(total.latencyUs, 0.999),
+           total.latencyUs.empty() ? 0 : total.latencyUs.back());
+    for (const std::vector<LoadUnit> &group : groups)
+    {
+        for (const LoadUnit &u : group)
+            close(u.fd);
+    }
+    return total.lost == 0 && total.failed == 0 && total.duplicates == 0 ? 0 : 2;
+}
@@ -0,0 +1,269 @@
+//
+//  linksim: the wireless sensor link over a simulated channel
+//    A node (sensor_link.h) samples a synthetic session on a clock of its own
+//    (offset, drift) and sends its batches over the host loopback link with
+//    delay, jitter and loss, both ways. With -r the node restarts partway:
+//    sequence and clock from 0 again. The device side is the real thing:
+//    sensorRemote feeding the sensor task, the detector and the rep counter.
+//    One row per node batch size, plus the pads wired to the ADC for reference:
+//      kbit/s      on air, with 28 bytes of IP + UDP per datagram
+//      lost        packets given up on / samples filled in for them
+//      reps        counted / presses (a rep later than 1s after its press is a miss)
+//      latency     press start to the rep popped by the UI side (end to end)
+//      onset err   rep time (receiver clock) - press start: clock sync error on top
+//                  of what the detector does wired
+//
+//  usage: linksim [-b batch] [-l loss_percent] [-d delay_ms] [-j jitter_ms] [-H hold_ms]
+//                 [-o offset_ms] [-p drift_ppm] [-r restart_s] [-s seed]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "hal_host.h"
+#include "detection.h"
+#include "detection_params.h"
+#include "sensor_task.h"
+#include "sensor_link.h"
+#include "rep_counter.h"
+#include "synth.h"
+
+static const uint16_t noBaseline[sampleChannels] = {0};
+static const uint32_t simMatchUs = 1000000;
+static const uint32_t simNodeTurnUs = 100; // Node: sync request in to reply out
+static const uint32_t simIpOverhead = 28;
+static const uint32_t simBootUs = 300000; // Node clock when it sends again after a restart
+static const int simBatches[] = {1, 2, 4, 8, 16, 32};
+
+struct SimChannel
+{
+    double loss;       // 0 ~ 1
+    uint32_t delayUs;  // One way, fixed part
+    uint32_t jitterUs; // Uniform 0 ~ jitterUs on top
+    int64_t offsetUs;  // Node clock at receiver time 0
+    int32_t driftPpm;  // Node clock faster (+)
+    uint32_t restartUs; // Node restart, receiver time. 0: none
+};
+
+struct SimResult
+{
+    uint64_t bytes;
+    uint32_t presses;
+    uint32_t counted;
+    uint32_t matched;
+    std::vector<uint32_t> latencyUs;
+    std::vector<int32_t> onsetErrUs;
+    SensorLinkStats link;
+};
+
+static SimChannel simChannel = {0.02, 3000, 4000, 5000000, 40, 0};
+static std::mt19937 simRandom;
+static SensorLinkNode simNode;
+static bool isSimRestarted;
+static uint64_t simBytes;
+
+static uint32_t simNodeClock(uint32_t localUs)
+{
+    int64_t nodeUs = localUs + simChannel.offsetUs;
+
+    if (simChannel.restartUs != 0 && localUs >= simChannel.restartUs)
+        nodeUs = localUs - simChannel.restartUs + simBootUs;
+    return (uint32_t)(nodeUs + (int64_t)localUs * simChannel.driftPpm / 1000000);
+}
+
+// Delay of one datagram, 0: lost
+static uint32_t simTransit(uint32_t len)
+{
+    simBytes += len + simIpOverhead;
+    if (std::uniform_real_distribution<double>(0, 1)(simRandom) < simChannel.loss)
+        return 0;
+    return simChannel.delayUs + std::uniform_int_distribution<uint32_t>(0, simChannel.jitterUs)(simRandom);
+}
+
+// Node sampling timer, on the receiver's timebase, stamped with the node clock
+static void simNodeTick()
+{
+    uint8_t packet[telemetryPacketMax];
+    AdcSample sample;
+    size_t len;
+    uint32_t delayUs;
+
+    if (simChannel.restartUs != 0 && halMicros() >= simChannel.restartUs && !isSimRestarted)
+    {
+        sensorNodeBegin(simNode, simNode.batch);
+        isSimRestarted = true;
+    }
+    sample.timeUs = simNodeClock(halMicros());
+    for (int ch = 0; ch < sampleChannels; ch++)
+        sample.value[ch] = halAdcRead(ch);
+    len = sensorNodePush(simNode, sample, packet);
+    if (len > 0 && (delayUs = simTransit(len)) > 0)
+        hostLinkDeliver(packet, len, delayUs);
+}
+
+// A sync request from the device: the node answers when it gets there
+static void simToNode(const uint8_t *data, uint32_t len)
+{
+    uint8_t reply[linkSyncReplyLen];
+    uint32_t inUs = simTransit(len);
+    uint32_t backUs;
+    size_t replyLen;
+
+    if (inUs == 0)
+        return;
+    replyLen = sensorNodeReply(data, len, simNodeClock(halMicros() + inUs),
+                               simNodeClock(halMicros() + inUs + simNodeTurnUs), reply);
+    if (replyLen > 0 && (backUs = simTransit(replyLen)) > 0)
+        hostLinkDeliver(reply, replyLen, inUs + simNodeTurnUs + backUs);
+}
+
+// batch 0: pads wired to the ADC
+static void simRun(const std::vector<AdcSample> &trace, const std::vector<SynthPress> &presses, int batch,
+                   SimResult &result)
+{
+    std::vector<bool> used(presses.size(), false);
+    RepEvent ev;
+
+    hostTraceSet(trace.data(), trace.size());
+    hostLinkSet(simToNode);
+    repEvents.clear();
+    simBytes = 0;
+    detectionBegin(sensorDetection, noBaseline, detectionTuned);
+    repCounterBegin(countAny);
+    if (batch == 0)
+        sensorTaskBegin(sensorLocal, sensorPins);
+    else
+    {
+        sensorNodeBegin(simNode, batch);
+        isSimRestarted = false;
+        halTimerStartPeriodic(1000000 / sampleRateHz, simNodeTick);
+        sensorTaskBegin(sensorRemote, NULL);
+    }
+
+    result.presses = presses.size();
+    result.counted = 0;
+    result.matched = 0;
+    result.latencyUs.clear();
+    result.onsetErrUs.clear();
+    while (!hostTraceDone())
+    {
+        hostAdvanceUs(1000);
+        while (repEvents.pop(ev))
+        {
+            if (!repCounterEvent(ev))
+                continue;
+            result.counted++;
+            // The earliest free press on its side it can belong to
+            for (size_t j = 0; j < presses.size(); j++)
+            {
+                const SynthPress &press = presses[j];
+                if (used[j] || press.side != ev.side || halMicros() < press.timeUs ||
+                    halMicros() - press.timeUs > simMatchUs)
+                    continue;
+                used[j] = true;
+                result.matched++;
+                result.latencyUs.push_back(halMicros() - press.timeUs);
+                result.onsetErrUs.push_back((int32_t)(ev.timeUs - press.timeUs));
+                break;
+            }
+        }
+    }
+    result.bytes = simBytes;
+    memset(&result.link, 0, sizeof(result.link));
+    if (batch > 0)
+        sensorLinkStats(result.link);
+}
+
+static double simPercentileMs(std::vector<uint32_t> &values, int percent)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[(values.size() - 1) * percent / 100] / 1e3;
+}
+
+static void simPrint(int batch, SimResult &r, double sec)
+{
+    std::vector<uint32_t> errAbs;
+
+    for (int32_t v : r.onsetErrUs)
+        errAbs.push_back(v < 0 ? -v : v);
+    if (batch == 0)
+        printf("wired      -       -          -   ");
+    else
+        printf("link  %5d  %6.1f  %4u / %4u   ", batch, r.bytes * 8 / sec / 1000, r.link.lost,
+               r.link.concealed);
+    printf("%3u / %3u  %6.1f %6.1f    %6.2f %6.2f\n", r.matched, r.presses, simPercentileMs(r.latencyUs, 50),
+           simPercentileMs(r.latencyUs, 99), simPercentileMs(errAbs, 50), simPercentileMs(errAbs, 99));
+}
+
+int main(int argc, char **argv)
+{
+    int onlyBatch = 0;
+    uint32_t holdUs = linkHoldUs;
+    unsigned seed = 1;
+    int opt;
+    SynthParams params;
+    std::vector<AdcSample> trace;
+    std::vector<SynthPress> presses;
+    SimResult result;
+    SensorLinkStats lastLink = {};
+
+    while ((opt = getopt(argc, argv, "b:l:d:j:H:o:p:r:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'b': onlyBatch = atoi(optarg); break;
+        case 'l': simChannel.loss = atof(optarg) / 100; break;
+        case 'd': simChannel.delayUs = atof(optarg) * 1000; break;
+        case 'j': simChannel.jitterUs = atof(optarg) * 1000; break;
+        case 'H': holdUs = atof(optarg) * 1000; break;
+        case 'o': simChannel.offsetUs = (int64_t)(atof(optarg) * 1000); break;
+        case 'p': simChannel.driftPpm = atoi(optarg); break;
+        case 'r': simChannel.restartUs = atof(optarg) * 1e6; break;
+        case 's': seed = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-b batch] [-l loss_percent] [-d delay_ms] [-j jitter_ms] [-H hold_ms] "
+                            "[-o offset_ms] [-p drift_ppm] [-r restart_s] [-s seed]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (onlyBatch < 0 || onlyBatch > telemetryBatch)
+    {
+        fprintf(stderr, "batch: 1 ~ %d samples\n", telemetryBatch);
+        return 1;
+    }
+
+    params.sets = 3;
+    params.reps = 30;
+    params.seed = seed;
+    synthSession(params, trace, presses);
+    sensorLinkSetHold(holdUs);
+    double sec = (trace.back().timeUs - trace.front().timeUs) / 1e6;
+    printf("channel: loss %.1f%%, delay %.1f ms + jitter 0 ~ %.1f ms, hold %.1f ms, "
+           "node clock %+.1f ms %+d ppm, %.0f s session\n\n",
+           simChannel.loss * 100, simChannel.delayUs / 1e3, simChannel.jitterUs / 1e3, holdUs / 1e3,
+           simChannel.offsetUs / 1e3, simChannel.driftPpm, sec);
+    printf("      batch  kbit/s  lost pkt / smp   reps       latency ms    onset err ms\n");
+    printf("                                                 p50    p99      p50    p99\n");
+    for (int i = -1; i < (int)(sizeof(simBatches) / sizeof(simBatches[0])); i++)
+    {
+        int batch = i < 0 ? 0 : simBatches[i];
+        if (onlyBatch != 0 && batch != 0 && batch != onlyBatch)
+            continue;
+        simRandom.seed(seed);
+        simRun(trace, presses, batch, result);
+        simPrint(batch, result, sec);
+        if (batch > 0)
+            lastLink = result.link;
+    }
+    printf("\nsync (last run): %u exchanges, rtt %u us, skew %+d ppm (expected %+d), %u late, %u bad, "
+           "%u node restarts\n",
+           lastLink.syncs, lastLink.rttUs, lastLink.skewPpm, -simChannel.driftPpm, lastLink.late, lastLink.bad,
+           lastLink.restarts);
+    return 0;
+}
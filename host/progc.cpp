@@ -0,0 +1,336 @@
+//
+//  progc: compile workout programs (workout_program.h) from text
+//    name Pyramid              program name
+//    exercise Lunge            steps below are of this exercise
+//    mode any|alt|both         count mode of the steps below
+//    cue set|superset|interval cue at the start of the steps below
+//    rest 45                   rest after each step below (seconds)
+//    set 20 [rest 60]          counted step: 20 reps
+//    timed 30 [rest 10]        timed step: 30 seconds
+//    repeat 3 ... end          the steps in between, 3 times (nests)
+//    # comment
+//    Repeats are unrolled, the device only steps through the flat table.
+//
+//  usage: progc program.txt ...                 list the compiled steps
+//         progc -o program.wkp program.txt      image for the SD card (/programs/1.wkp)
+//         progc -H workout_programs.h program.txt ...   built-in programs
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "audio_cue.h"
+#include "rep_counter.h"
+#include "workout_program.h"
+
+static const char *const progModes[countModes] = {"any", "alt", "both"};
+static const char *const progCues[] = {"set", "superset", "interval"};
+static const uint8_t progCueIds[] = {cueSetStart, cueSuperset, cueInterval};
+
+struct ProgSource
+{
+    const char *path;
+    int line;
+};
+
+static bool progError(const ProgSource &src, const char *message, const char *arg = "")
+{
+    fprintf(stderr, "%s:%d: %s%s\n", src.path, src.line, message, arg);
+    return false;
+}
+
+static int progLookup(const char *word, const char *const *names, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (word != NULL && strcmp(word, names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static bool progNumber(const char *word, int max, int &value)
+{
+    char *end;
+    long v;
+
+    if (word == NULL)
+        return false;
+    v = strtol(word, &end, 10);
+    if (*end != 0 || v < 0 || v > max)
+        return false;
+    value = v;
+    return true;
+}
+
+static bool progCompile(const char *path, ProgramImage &image)
+{
+    FILE *fp = fopen(path, "r");
+    ProgSource src = {path, 0};
+    std::vector<std::pair<int, int>> repeats; // Count, first step
+    ProgramStep current = {0, 0, 0, countAny, cueSetStart, 0, {0, 0, 0}};
+    char line[256];
+    bool isOk = true;
+
+    if (fp == NULL)
+    {
+        perror(path);
+        return false;
+    }
+    memset(&image, 0, sizeof(image));
+    image.magic = programMagic;
+    while (isOk && fgets(line, sizeof(line), fp))
+    {
+        char *hash = strchr(line, '#');
+        char *cmd, *arg, *opt;
+        int value = 0;
+
+        src.line++;
+        if (hash != NULL)
+            *hash = 0;
+        cmd = strtok(line, " \t\r\n");
+        if (cmd == NULL)
+            continue;
+        arg = strtok(NULL, " \t\r\n");
+
+        if (strcmp(cmd, "name") == 0)
+        {
+            if (arg == NULL || strlen(arg) >= programNameMax)
+                isOk = progError(src, "name missing or longer than 15 characters");
+            else
+                strcpy(image.name, arg);
+        }
+        else if (strcmp(cmd, "exercise") == 0)
+        {
+            int i;
+            for (i = 0; i < image.exerciseCount && arg != NULL; i++)
+            {
+                if (strcmp(image.exercises[i], arg) == 0)
+                    break;
+            }
+            if (arg == NULL || strlen(arg) >= programExerciseNameMax)
+                isOk = progError(src, "exercise missing or longer than 11 characters");
+            else if (i == programExerciseMax)
+                isOk = progError(src, "more than 4 exercises");
+            else
+            {
+                if (i == image.exerciseCount)
+                    strcpy(image.exercises[image.exerciseCount++], arg);
+                current.exercise = i;
+            }
+        }
+        else if (strcmp(cmd, "mode") == 0)
+        {
+            value = progLookup(arg, progModes, countModes);
+            if (value < 0)
+                isOk = progError(src, "mode must be any, alt or both");
+            current.mode = value;
+        }
+        else if (strcmp(cmd, "cue") == 0)
+        {
+            value = progLookup(arg, progCues, sizeof(progCues) / sizeof(progCues[0]));
+            if (value < 0)
+                isOk = progError(src, "cue must be set, superset or interval");
+            else
+                current.cue = progCueIds[value];
+        }
+        else if (strcmp(cmd, "rest") == 0)
+        {
+            if (!progNumber(arg, 3600, value))
+                isOk = progError(src, "rest needs seconds (0 - 3600)");
+            current.restSec = value;
+        }
+        else if (strcmp(cmd, "set") == 0 || strcmp(cmd, "timed") == 0)
+        {
+            ProgramStep step = current;
+            bool isTimed = cmd[0] == 't';
+
+            if (!progNumber(arg, isTimed ? 3600 : 999, value) || value == 0)
+                isOk = progError(src, isTimed ? "timed needs seconds (1 - 3600)" : "set needs reps (1 - 999)");
+            step.reps = isTimed ? 0 : value;
+            step.workSec = isTimed ? value : 0;
+            opt = strtok(NULL, " \t\r\n");
+            if (opt != NULL)
+            {
+                if (strcmp(opt, "rest") != 0 || !progNumber(strtok(NULL, " \t\r\n"), 3600, value))
+                    isOk = progError(src, "expected: rest <seconds>");
+                step.restSec = value;
+            }
+            if (image.stepCount == programStepMax)
+                isOk = progError(src, "more than 32 steps");
+            else if (isOk)
+                image.steps[image.stepCount++] = step;
+        }
+        else if (strcmp(cmd, "repeat") == 0)
+        {
+            if (!progNumber(arg, programStepMax, value) || value == 0)
+                isOk = progError(src, "repeat needs a count (1 - 32)");
+            repeats.push_back(std::make_pair(value, (int)image.stepCount));
+        }
+        else if (strcmp(cmd, "end") == 0)
+        {
+            if (repeats.empty())
+            {
+                isOk = progError(src, "end without repeat");
+                break;
+            }
+            int first = repeats.back().second;
+            int len = image.stepCount - first;
+            for (int n = 1; n < repeats.back().first && isOk; n++)
+            {
+                if (image.stepCount + len > programStepMax)
+                    isOk = progError(src, "more than 32 steps after the repeat");
+                else
+                {
+                    memcpy(&image.steps[image.stepCount], &image.steps[first], len * sizeof(ProgramStep));
+                    image.stepCount += len;
+                }
+            }
+            repeats.pop_back();
+        }
+        else
+            isOk = progError(src, "unknown statement ", cmd);
+    }
+    fclose(fp);
+    if (!isOk)
+        return false;
+    if (!repeats.empty())
+        return progError(src, "repeat without end");
+    if (image.stepCount == 0)
+        return progError(src, "no set or timed step");
+    if (image.name[0] == 0)
+        return progError(src, "no name");
+    image.steps[image.stepCount - 1].restSec = 0; // Finished after the last step
+    image.check = programChecksum(image);
+    return programCheck(image) || progError(src, "program failed the device check");
+}
+
+static void progList(const ProgramImage &image)
+{
+    uint32_t reps = 0;
+
+    for (int i = 0; i < image.stepCount; i++)
+        reps += image.steps[i].reps;
+    printf("%s: %u steps, %u reps\n", image.name, image.stepCount, reps);
+    for (int i = 0; i < image.stepCount; i++)
+    {
+        const ProgramStep &s = image.steps[i];
+        printf("  %2d  %-11s ", i + 1, image.exerciseCount > 0 ? image.exercises[s.exercise] : "-");
+        if (s.reps != 0)
+            printf("%3u reps", s.reps);
+        else
+            printf("%3u sec ", s.workSec);
+        printf("  rest %3u  mode %-4s  cue %s\n", s.restSec, progModes[s.mode],
+               s.cue == cueSuperset ? "superset" : s.cue == cueInterval ? "interval" : "set");
+    }
+}
+
+static void progWriteString(FILE *fp, const char *s)
+{
+    fputc('"', fp);
+    for (; *s != 0; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            fputc('\\', fp);
+        fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+static bool progWriteHeader(const char *path, const std::vector<ProgramImage> &images,
+                            const std::vector<std::string> &sources)
+{
+    FILE *fp = fopen(path, "w");
+
+    if (fp == NULL)
+    {
+        perror(path);
+        return false;
+    }
+    fprintf(fp, "//\n//  Built-in workout programs, generated by host/progc from\n//   ");
+    for (const std::string &s : sources)
+        fprintf(fp, " %s", s.c_str());
+    fprintf(fp, "\n//  (make programs). Edit the sources, not this file.\n//\n");
+    fprintf(fp, "#pragma once\n\n#include \"workout_program.h\"\n\n");
+    for (size_t n = 0; n < images.size(); n++)
+    {
+        const ProgramImage &p = images[n];
+        fprintf(fp, "const ProgramImage programBuiltin%zu = {\n    0x%08x, %u, %u, 0x%04x, ", n + 1, p.magic,
+                p.stepCount, p.exerciseCount, p.check);
+        progWriteString(fp, p.name);
+        fprintf(fp, ",\n    {");
+        for (int i = 0; i < programExerciseMax; i++)
+        {
+            fprintf(fp, i > 0 ? ", " : "");
+            progWriteString(fp, p.exercises[i]);
+        }
+        fprintf(fp, "},\n    {\n");
+        for (int i = 0; i < p.stepCount; i++)
+        {
+            const ProgramStep &s = p.steps[i];
+            fprintf(fp, "        {%u, %u, %u, %u, %u, %u, {0, 0, 0}},\n", s.reps, s.workSec, s.restSec, s.mode,
+                    s.cue, s.exercise);
+        }
+        fprintf(fp, "    }};\n\n");
+    }
+    fprintf(fp, "const ProgramImage *const programBuiltins[] = {");
+    for (size_t n = 0; n < images.size(); n++)
+        fprintf(fp, "%s&programBuiltin%zu", n > 0 ? ", " : "", n + 1);
+    fprintf(fp, "};\nconst int programBuiltinCount = %zu;\n", images.size());
+    fclose(fp);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *binaryPath = NULL;
+    const char *headerPath = NULL;
+    std::vector<ProgramImage> images;
+    std::vector<std::string> sources;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:H:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'o': binaryPath = optarg; break;
+        case 'H': headerPath = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-o program.wkp | -H workout_programs.h] program.txt ...\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc || (binaryPath != NULL && argc - optind != 1))
+    {
+        fprintf(stderr, "usage: %s [-o program.wkp | -H workout_programs.h] program.txt ...\n", argv[0]);
+        return 1;
+    }
+    for (int i = optind; i < argc; i++)
+    {
+        ProgramImage image;
+        if (!progCompile(argv[i], image))
+            return 2;
+        images.push_back(image);
+        const char *base = strrchr(argv[i], '/');
+        sources.push_back(base != NULL ? base + 1 : argv[i]);
+    }
+
+    if (binaryPath != NULL)
+    {
+        FILE *fp = fopen(binaryPath, "wb");
+        if (fp == NULL || fwrite(&images[0], sizeof(ProgramImage), 1, fp) != 1)
+        {
+            perror(binaryPath);
+            return 1;
+        }
+        fclose(fp);
+    }
+    else if (headerPath != NULL && !progWriteHeader(headerPath, images, sources))
+        return 1;
+    for (const ProgramImage &image : images)
+        progList(image);
+    return 0;
+}
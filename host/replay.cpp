@@ -0,0 +1,182 @@
+//
+//  replay: run the rep detection against a recorded ADC trace
+//    Same flow as showRunningScreen() / showSetRepScreen() / showRestScreen(),
+//    without drawing. The virtual clock makes a full session replay in milliseconds.
+//
+//  usage: replay [-s sets] [-r reps] [-t rest sec] [-m any|alt|both]
+//                [-T stream.bin (raw sensor stream, as over Serial at 115200)]
+//                [-H sd_root (log the session history there)] trace.txt
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include "hal_host.h"
+#include "sampler.h"
+#include "detector.h"
+#include "detection.h"
+#include "detection_params.h"
+#include "sensor_task.h"
+#include "rep_stats.h"
+#include "rep_counter.h"
+#include "probe.h"
+#include "telemetry.h"
+#include "history.h"
+#include "trace.h"
+
+static const uint16_t noBaseline[sampleChannels] = {0};
+static RunningStat detectLatency; // Press onset to detection (sensor), in 0.1ms
+
+static void printRepStats(const char *label, const RepStats &stats)
+{
+    printf("%s interval %u ms sd %u p50 %u p90 %u drift %+d/rep, press %u ms min %u max %u\n",
+           label, statMeanMs(stats.intervalMs), statStdDevMs(stats.intervalMs),
+           statPercentileMs(stats.intervalMs, 50), statPercentileMs(stats.intervalMs, 90),
+           repStatsDriftMs(stats), statMeanMs(stats.pressMs), stats.pressMs.minMs,
+           stats.pressMs.maxMs);
+    printf("%s R/L presses %u/%u, L-R press %+d ms step %+d ms\n", label, stats.sidePresses[0],
+           stats.sidePresses[1], repStatsPressAsymMs(stats), repStatsStepAsymMs(stats));
+}
+
+// Equivalent of the set / rep screen: returns the number of reps counted
+static int replaySet(int currentSet, int repMax, CountMode mode)
+{
+    int currentRep = 0;
+    RepEvent ev;
+
+    repEvents.clear(); // Ignore presses during the rest time
+    repStatsBeginSet();
+    repCounterBegin(mode);
+    while (!hostTraceDone() && currentRep < repMax)
+    {
+        while (currentRep < repMax && repEvents.pop(ev))
+        {
+            if (ev.type == repEventPress)
+                repStatsPress(ev.side, ev.timeUs);
+            else
+                repStatsRelease(ev.side, ev.timeUs);
+            if (!repCounterEvent(ev))
+                continue;
+            repStatsRep(ev.timeUs);
+            currentRep++;
+            historyAddRep(currentSet, ev.side, currentRep, ev.timeUs);
+            statAdd(detectLatency, ev.latencyUs / 100);
+            PROBE_RECORD_US(probeRepLatency, halMicros() - ev.timeUs);
+            printf("set %d rep %2d at %10.3f s (%c, detected %.1f ms, counted %.1f ms after)\n",
+                   currentSet, currentRep, ev.timeUs / 1e6, ev.side ? 'L' : 'R',
+                   ev.latencyUs / 1e3, (halMicros() - ev.timeUs) / 1e3);
+        }
+        halDelay(swReadInterval);
+        historyPoll();
+    }
+    historyEndSet(currentSet, currentRep, statMeanMs(repStatsSet().intervalMs));
+    printRepStats("set", repStatsSet());
+    return currentRep;
+}
+
+static void printLine(const char *line)
+{
+    printf("%s\n", line);
+}
+
+static bool parseMode(const char *name, CountMode &mode)
+{
+    static const char *const names[countModes] = {"any", "alt", "both"};
+
+    for (int i = 0; i < countModes; i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            mode = (CountMode)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    int setMax = 5;
+    int repMax = 40;
+    int restTime = 45;
+    int totalReps = 0;
+    CountMode mode = countAny;
+    int opt;
+    std::vector<AdcSample> trace;
+    FILE *streamFile = NULL;
+    const char *historyRoot = NULL;
+
+    while ((opt = getopt(argc, argv, "s:r:t:m:T:H:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': setMax = atoi(optarg); break;
+        case 'H': historyRoot = optarg; break;
+        case 'r': repMax = atoi(optarg); break;
+        case 't': restTime = atoi(optarg); break;
+        case 'm':
+            if (parseMode(optarg, mode))
+                break;
+            // Fall through
+        case 'T':
+            if (opt == 'T' && (streamFile = fopen(optarg, "wb")) != NULL)
+                break;
+            // Fall through
+        default:
+            fprintf(stderr, "usage: %s [-s sets] [-r reps] [-t rest] [-m any|alt|both] [-T stream.bin] "
+                            "[-H sd_root] trace.txt\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc || !traceLoad(argv[optind], trace))
+    {
+        fprintf(stderr, "cannot read trace\n");
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    hostTraceSet(trace.data(), trace.size());
+    detectionBegin(sensorDetection, noBaseline, detectionTuned);
+    sensorTaskBegin(sensorLocal, sensorPins);
+    if (streamFile != NULL)
+    {
+        hostSerialCapture(streamFile, 115200);
+        telemetryStart();
+    }
+    repStatsBeginSession();
+    statReset(detectLatency);
+    hostStorageSet(historyRoot);
+    halSetEpochSeconds(time(NULL));
+    historyBegin();
+    historyBeginSession(mode, setMax, repMax);
+    for (int sets = 1; sets <= setMax && !hostTraceDone(); sets++)
+    {
+        totalReps += replaySet(sets, repMax, mode);
+        if (sets < setMax)
+            halDelay(restTime * 1000);
+    }
+    historyEndSession(setMax, totalReps, totalReps < setMax * repMax);
+    for (int i = 0; i < historySectorsPending + 1; i++)
+        historyPoll(); // Write out what is left
+    while (streamFile != NULL && !hostTraceDone())
+        halDelay(swReadInterval); // Stream the whole trace
+    double wallMs = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start).count();
+
+    printRepStats("session", repStatsSession());
+    probeReport(printLine);
+    printf("detection latency mean %.1f ms p90 %.1f max %.1f\n", statMeanMs(detectLatency) / 10.0,
+           statPercentileMs(detectLatency, 90) / 10.0, detectLatency.maxMs / 10.0);
+    if (streamFile != NULL)
+    {
+        fclose(streamFile);
+        printf("stream %u packets, %u samples dropped\n", telemetryPackets(), telemetryDropped());
+    }
+    printf("reps %d / %d, overruns %u\n", totalReps, setMax * repMax, samplerOverruns());
+    printf("replayed %.1f s in %.1f ms (x%.0f)\n", halMicros() / 1e6, wallMs,
+           halMicros() / 1e3 / wallMs);
+    return totalReps == setMax * repMax ? 0 : 2;
+}
@@ -0,0 +1,122 @@
+//
+//  storecheck: the settings store (settings_store.h) on the emulated flash
+//    Commits enough records to wrap the log around the sectors several times.
+//    Before every commit the power is cut at each flash operation in turn: after
+//    the reboot the store must come back with the settings before the commit, or
+//    the new ones, never without any. After the commit that goes through, the
+//    reboot must find it (the sector scan + binary search of storeFindNewest()).
+//    Runs on the 2 x 4KB partition and the 2 x 512 byte NVS fallback layout, with
+//    clean cuts and with torn ones, where the cut write or erase is half done.
+//
+//  usage: storecheck [-n commits]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "hal_host.h"
+#include "settings_store.h"
+
+const int checkOpsMax = 3; // A commit erases a sector at most once and writes one slot
+const uint32_t checkSectors[] = {4096, 512};
+
+static void checkPayload(uint32_t n, uint8_t *payload)
+{
+    for (int i = 0; i < settingsPayloadSize; i++)
+        payload[i] = n >> (i % 4 * 8) ^ i;
+}
+
+// Reboot: what the store comes back with. -1: nothing, -2: not one of the commits
+static int64_t checkReboot(uint32_t newest)
+{
+    uint8_t payload[settingsPayloadSize];
+    uint8_t expected[settingsPayloadSize];
+    uint8_t version;
+
+    if (!settingsStoreBegin() || !settingsStoreLoad(payload, version))
+        return -1;
+    for (uint32_t n = newest + 1; n-- > 0 && n + checkOpsMax > newest;)
+    {
+        checkPayload(n, expected);
+        if (memcmp(payload, expected, settingsPayloadSize) == 0)
+            return n;
+    }
+    return -2;
+}
+
+// Failures of one layout and kind of cut
+static uint32_t checkRun(uint32_t sectorSize, bool isTorn, uint32_t commits)
+{
+    uint32_t cuts = 0;
+    uint32_t failures = 0;
+    uint8_t payload[settingsPayloadSize];
+
+    hostFlashLayout(sectorSize);
+    hostFlashCut(-1, false);
+    checkPayload(0, payload);
+    settingsStoreBegin();
+    settingsStoreStage(payload);
+    if (!settingsStoreCommit() || checkReboot(0) != 0)
+    {
+        printf("2 x %u: first commit not found\n", sectorSize);
+        return 1;
+    }
+    for (uint32_t n = 1; n <= commits; n++)
+    {
+        int64_t found;
+
+        for (int ops = 0; ops < checkOpsMax; ops++)
+        {
+            checkPayload(n, payload);
+            hostFlashCut(ops, isTorn);
+            settingsStoreStage(payload);
+            bool isDone = settingsStoreCommit();
+            hostFlashCut(-1, false);
+            found = checkReboot(n);
+            if (found != n - 1 && found != n)
+            {
+                printf("2 x %u: commit %u, %s power cut after %d operations: found %lld\n", sectorSize, n,
+                       isTorn ? "torn" : "clean", ops, (long long)found);
+                failures++;
+            }
+            cuts++;
+            if (isDone)
+                break;
+        }
+        checkPayload(n, payload);
+        settingsStoreStage(payload);
+        if (!settingsStoreCommit() || (found = checkReboot(n)) != n)
+        {
+            printf("2 x %u: commit %u not found after the reboot (%lld)\n", sectorSize, n, (long long)found);
+            failures++;
+        }
+    }
+    printf("2 x %4u bytes, %s cuts: %u commits (sequence %u), %u power cuts, %u failures\n", sectorSize,
+           isTorn ? "torn " : "clean", commits, settingsStoreSequence(), cuts, failures);
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t commits = 0; // 0: four times around the two sectors
+    uint32_t failures = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        if (opt != 'n')
+        {
+            fprintf(stderr, "usage: %s [-n commits]\n", argv[0]);
+            return 1;
+        }
+        commits = atoi(optarg);
+    }
+
+    for (uint32_t sectorSize : checkSectors)
+    {
+        for (int torn = 0; torn < 2; torn++)
+            failures += checkRun(sectorSize, torn, commits != 0 ? commits : 4 * 2 * sectorSize / 16 + 5);
+    }
+    return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,145 @@
+//
+//  Synthetic FSR traces
+//
+
+#include <stddef.h>
+#include "synth.h"
+
+static unsigned synthRandState;
+
+struct SynthGlitch
+{
+    uint32_t startUs;
+    uint32_t endUs;
+    int side;
+};
+
+// xorshift32
+static unsigned synthRandNext()
+{
+    synthRandState ^= synthRandState << 13;
+    synthRandState ^= synthRandState >> 17;
+    synthRandState ^= synthRandState << 5;
+    return synthRandState;
+}
+
+static int synthRand(int amplitude)
+{
+    // Sum of two for a rough triangular distribution
+    int sum = 0;
+    for (int i = 0; i < 2; i++)
+        sum += (int)(synthRandNext() % (2 * amplitude + 1)) - amplitude;
+    return sum / 2;
+}
+
+// Pressure envelope 0..1024 for a press starting at start (us)
+static int synthEnvelope(const SynthParams &p, int64_t t, int64_t start)
+{
+    int64_t ramp = (int64_t)p.rampMs * 1000;
+    int64_t hold = (int64_t)p.holdMs * 1000;
+    int64_t dt = t - start;
+
+    if (dt < 0 || dt > hold + ramp)
+        return 0;
+    if (dt < ramp)
+        return (int)(dt * 1024 / ramp);
+    if (dt < hold)
+        return 1024;
+    return (int)((hold + ramp - dt) * 1024 / ramp);
+}
+
+static SynthParams synthCorpusParams(int period, int hold, int ramp, bool alternate, int pressLevel,
+                                     int noise, int glitchPerMin, int glitchMaxMs)
+{
+    SynthParams p;
+
+    p.sets = 2;
+    p.reps = 30;
+    p.restSec = 20;
+    p.repPeriodMs = period;
+    p.holdMs = hold;
+    p.rampMs = ramp;
+    p.alternate = alternate;
+    p.pressLevel = pressLevel;
+    p.noise = noise;
+    p.glitchPerMin = glitchPerMin;
+    p.glitchMaxMs = glitchMaxMs;
+    return p;
+}
+
+// Synthetic corpus, each one shaped after a movement or a failure seen on the pads
+const SynthScenario synthCorpus[] = {
+    {"lunges",       countAlternate, synthCorpusParams(2000, 600, 40, true, 1000, 30, 0, 30)},
+    {"lunges-noisy", countAlternate, synthCorpusParams(2000, 600, 40, true, 1000, 400, 0, 30)},
+    {"pushups",      countAny,       synthCorpusParams(1500, 350, 120, false, 1000, 30, 0, 30)},
+    {"slow-presses", countAny,       synthCorpusParams(3000, 900, 300, false, 1000, 30, 0, 30)},
+    {"fast-steps",   countAlternate, synthCorpusParams(700, 250, 25, true, 1000, 30, 0, 30)},
+    {"shallow",      countAlternate, synthCorpusParams(2000, 600, 40, true, 1500, 30, 0, 30)},
+    {"noise-bursts", countAlternate, synthCorpusParams(2000, 600, 40, true, 1000, 200, 60, 20)},
+    {"knocks",       countAlternate, synthCorpusParams(2000, 600, 40, true, 1000, 30, 120, 10)},
+};
+
+const int synthCorpusSize = sizeof(synthCorpus) / sizeof(synthCorpus[0]);
+
+void synthSession(const SynthParams &p, std::vector<AdcSample> &trace,
+                  std::vector<SynthPress> &presses)
+{
+    const uint32_t periodUs = 1000000 / sampleRateHz;
+    uint32_t t = 2000000; // Lead-in before the first press
+    int side = 0;
+
+    synthRandState = p.seed ? p.seed : 1;
+    presses.clear();
+    for (int set = 0; set < p.sets; set++)
+    {
+        for (int rep = 0; rep < p.reps; rep++)
+        {
+            presses.push_back({t, side, set});
+            if (p.alternate)
+                side ^= 1;
+            t += p.repPeriodMs * 1000;
+        }
+        t += p.restSec * 1000000 + 3000000;
+    }
+
+    // Glitches: [start, end) per side, never on top of a real press
+    std::vector<SynthGlitch> glitches;
+    uint32_t glitchCount = p.glitchPerMin * (uint64_t)t / 60000000;
+    for (uint32_t i = 0; i < glitchCount; i++)
+    {
+        uint32_t start = (uint32_t)(synthRandNext() % t);
+        uint32_t len = (1 + synthRandNext() % p.glitchMaxMs) * 1000;
+        glitches.push_back({start, start + len, (int)(synthRandNext() % sampleChannels)});
+    }
+
+    trace.clear();
+    size_t next = 0;
+    for (uint32_t now = 0; now < t; now += periodUs)
+    {
+        AdcSample s;
+        int env[sampleChannels] = {0};
+
+        // Presses are sorted, only the ones around now can contribute
+        while (next < presses.size() &&
+               (int64_t)presses[next].timeUs + (p.holdMs + p.rampMs) * 1000 < now)
+            next++;
+        for (size_t i = next; i < presses.size() && presses[i].timeUs <= now; i++)
+        {
+            int e = synthEnvelope(p, now, presses[i].timeUs);
+            if (e > env[presses[i].side])
+                env[presses[i].side] = e;
+        }
+        for (const SynthGlitch &g : glitches)
+        {
+            if (now >= g.startUs && now < g.endUs && env[g.side] == 0)
+                env[g.side] = 1024;
+        }
+        s.timeUs = now;
+        for (int ch = 0; ch < sampleChannels; ch++)
+        {
+            int v = p.idleLevel - (p.idleLevel - p.pressLevel) * env[ch] / 1024 + synthRand(p.noise);
+            s.value[ch] = (uint16_t)(v < 0 ? 0 : v > 4095 ? 4095 : v);
+        }
+        trace.push_back(s);
+    }
+}
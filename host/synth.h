@@ -0,0 +1,48 @@
+//
+//  Synthetic FSR traces
+//    Generates sessions shaped like the real sensor: ~3600 idle (pull-up),
+//    falling towards ~1000 while a foot / knee is on the pad.
+//
+#pragma once
+
+#include <vector>
+#include "sampler.h"
+#include "rep_counter.h"
+
+struct SynthParams
+{
+    int sets = 5;
+    int reps = 40;
+    int restSec = 45;
+    int repPeriodMs = 2000; // Time between presses
+    int holdMs = 600;       // Press duration
+    int rampMs = 40;        // Rise / fall time of the pressure
+    bool alternate = true;  // Right, left, right... (false: right only)
+    int idleLevel = 3600;
+    int pressLevel = 1000;
+    int noise = 30;         // Peak noise amplitude
+    int glitchPerMin = 0;   // Short full depth dips (knocks, cable), random side
+    int glitchMaxMs = 30;   // Glitch length: 1 ~ glitchMaxMs
+    unsigned seed = 1;
+};
+
+struct SynthPress
+{
+    uint32_t timeUs; // Time the pressure starts to rise
+    int side;
+    int set;
+};
+
+// Labeled corpus shared by bench and tune: 2 x 30 reps of each
+struct SynthScenario
+{
+    const char *name;
+    CountMode mode;
+    SynthParams params;
+};
+
+extern const SynthScenario synthCorpus[];
+extern const int synthCorpusSize;
+
+void synthSession(const SynthParams &p, std::vector<AdcSample> &trace,
+                  std::vector<SynthPress> &presses);
@@ -0,0 +1,93 @@
+//
+//  teledump: decode a raw sensor stream capture (telemetry.h) into a trace file
+//    Capture on Linux, after sending 'b' to the device:
+//      stty -F /dev/ttyUSB0 115200 raw && cat /dev/ttyUSB0 > capture.bin
+//    Lost packets (sequence gaps) and samples the device dropped are reported on
+//    stderr and marked with a comment line in the trace. Text the firmware
+//    printed in between fails the CRC and is skipped.
+//
+//  usage: teledump [capture.bin] > trace.txt
+//
+
+#include <stdio.h>
+#include <vector>
+#include "telemetry.h"
+#include "trace.h"
+
+struct DumpStats
+{
+    uint32_t packets;
+    uint32_t samples;
+    uint32_t badFrames;
+    uint32_t lostPackets;
+    uint32_t droppedSamples;
+};
+
+static void dumpFrame(const std::vector<uint8_t> &frame, DumpStats &stats, bool &isFirst,
+                      TelemetryHeader &last)
+{
+    uint8_t packet[telemetryFrameMax];
+    AdcSample samples[telemetryBatch];
+    TelemetryHeader header;
+    size_t len;
+
+    if (frame.empty())
+        return; // Between two delimiters
+    len = frame.size() <= sizeof(packet) ? cobsDecode(frame.data(), frame.size(), packet) : 0;
+    if (len == 0 || !telemetryUnpack(packet, len, header, samples))
+    {
+        stats.badFrames++;
+        return;
+    }
+    if (!isFirst)
+    {
+        uint16_t lost = header.sequence - last.sequence - 1;
+        uint16_t dropped = header.dropped - last.dropped;
+        if (lost != 0 || dropped != 0)
+        {
+            printf("# gap before %u: %u packets lost, %u samples dropped on the device\n",
+                   samples[0].timeUs, lost, dropped);
+            stats.lostPackets += lost;
+            stats.droppedSamples += dropped;
+        }
+    }
+    isFirst = false;
+    last = header;
+    stats.packets++;
+    stats.samples += header.count;
+    for (int i = 0; i < header.count; i++)
+        traceWriteSample(stdout, samples[i]);
+}
+
+int main(int argc, char **argv)
+{
+    FILE *fp = argc > 1 ? fopen(argv[1], "rb") : stdin;
+    std::vector<uint8_t> frame;
+    DumpStats stats = {};
+    TelemetryHeader last = {};
+    bool isFirst = true;
+    int c;
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+    traceWriteHeader(stdout, argc > 1 ? argv[1] : "stdin");
+    while ((c = fgetc(fp)) != EOF)
+    {
+        if (c != 0)
+        {
+            frame.push_back(c);
+            continue;
+        }
+        dumpFrame(frame, stats, isFirst, last);
+        frame.clear();
+    }
+    if (fp != stdin)
+        fclose(fp);
+
+    fprintf(stderr, "%u packets, %u samples, %u bad frames, %u packets lost, %u samples dropped\n",
+            stats.packets, stats.samples, stats.badFrames, stats.lostPackets, stats.droppedSamples);
+    return stats.packets > 0 ? 0 : 2;
+}
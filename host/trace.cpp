@@ -0,0 +1,81 @@
+//
+//  ADC trace files
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+bool traceLoad(const char *path, std::vector<AdcSample> &trace)
+{
+    FILE *fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    char line[128];
+
+    if (fp == NULL)
+        return false;
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        AdcSample s;
+        char *p = line;
+        char *end;
+        int ch;
+
+        if (line[0] == '#')
+            continue;
+        s.timeUs = (uint32_t)strtoul(p, &end, 10);
+        if (end == p)
+            continue;
+        for (ch = 0; ch < sampleChannels; ch++)
+        {
+            p = end;
+            s.value[ch] = (uint16_t)strtoul(p, &end, 10);
+            if (end == p)
+                break;
+        }
+        if (ch == sampleChannels)
+            trace.push_back(s);
+    }
+    if (fp != stdin)
+        fclose(fp);
+    return true;
+}
+
+bool traceLoadLabels(const char *path, std::vector<TraceLabel> &labels)
+{
+    FILE *fp = fopen(path, "r");
+    char line[128];
+    unsigned long t;
+    int side;
+
+    if (fp == NULL)
+        return false;
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (sscanf(line, "# press %lu %d", &t, &side) == 2)
+            labels.push_back({(uint32_t)t, side});
+    }
+    fclose(fp);
+    return true;
+}
+
+void traceWriteHeader(FILE *fp, const char *comment)
+{
+    fprintf(fp, "# %s\n# timeUs right left", comment);
+    for (int ch = 2; ch < sampleChannels; ch++)
+        fprintf(fp, " ch%d", ch);
+    fputc('\n', fp);
+}
+
+void traceWriteLabel(FILE *fp, const TraceLabel &label)
+{
+    fprintf(fp, "# press %u %d\n", label.timeUs, label.side);
+}
+
+void traceWriteSample(FILE *fp, const AdcSample &sample)
+{
+    fprintf(fp, "%u", sample.timeUs);
+    for (int ch = 0; ch < sampleChannels; ch++)
+        fprintf(fp, " %u", sample.value[ch]);
+    fputc('\n', fp);
+}
@@ -0,0 +1,23 @@
+//
+//  ADC trace files
+//    Text, one sample per line: "<timeUs> <right> <left> [<ch2> ...]" (sampleChannels
+//    values), '#' starts a comment.
+//    Labels (true presses) ride along as comments: "# press <timeUs> <side>".
+//
+#pragma once
+
+#include <stdio.h>
+#include <vector>
+#include "sampler.h"
+
+struct TraceLabel
+{
+    uint32_t timeUs; // Pressure starts to rise
+    int side;
+};
+
+bool traceLoad(const char *path, std::vector<AdcSample> &trace);
+bool traceLoadLabels(const char *path, std::vector<TraceLabel> &labels);
+void traceWriteHeader(FILE *fp, const char *comment);
+void traceWriteSample(FILE *fp, const AdcSample &sample);
+void traceWriteLabel(FILE *fp, const TraceLabel &label);
@@ -0,0 +1,54 @@
+//
+//  tracegen: write a synthetic session trace to stdout
+//
+//  usage: tracegen [-s sets] [-r reps] [-t rest sec] [-p rep period ms]
+//                  [-h hold ms] [-n noise] [-g glitches per min] [-G glitch max ms]
+//                  [-1 (one side)] [-S seed]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "synth.h"
+#include "trace.h"
+
+int main(int argc, char **argv)
+{
+    SynthParams p;
+    std::vector<AdcSample> trace;
+    std::vector<SynthPress> presses;
+    char comment[128];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:r:t:p:h:n:g:G:1S:")) != -1)
+    {
+        switch (opt)
+        {
+        case 's': p.sets = atoi(optarg); break;
+        case 'r': p.reps = atoi(optarg); break;
+        case 't': p.restSec = atoi(optarg); break;
+        case 'p': p.repPeriodMs = atoi(optarg); break;
+        case 'h': p.holdMs = atoi(optarg); break;
+        case 'n': p.noise = atoi(optarg); break;
+        case 'g': p.glitchPerMin = atoi(optarg); break;
+        case 'G': p.glitchMaxMs = atoi(optarg); break;
+        case '1': p.alternate = false; break;
+        case 'S': p.seed = (unsigned)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-s sets] [-r reps] [-t rest] [-p period ms] [-h hold ms] "
+                            "[-n noise] [-g glitch/min] [-G glitch ms] [-1] [-S seed]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    synthSession(p, trace, presses);
+    snprintf(comment, sizeof(comment),
+             "synthetic: %d sets x %d reps, rest %ds, period %dms, noise %d, glitch %d/min",
+             p.sets, p.reps, p.restSec, p.repPeriodMs, p.noise, p.glitchPerMin);
+    traceWriteHeader(stdout, comment);
+    for (const SynthPress &press : presses)
+        traceWriteLabel(stdout, {press.timeUs, press.side});
+    for (const AdcSample &s : trace)
+        traceWriteSample(stdout, s);
+    return 0;
+}
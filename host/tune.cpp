@@ -0,0 +1,385 @@
+//
+//  tune: search the detection parameters (DetectionParams) on labeled traces
+//    and write them as detection_params.h for the firmware build.
+//    The median / low-pass stages don't depend on the parameters, so every trace
+//    is smoothed once and shared read-only; a candidate only replays
+//    detectionDecide(). Evaluations (candidate x trace) are spread over a pool
+//    of worker threads, one per core.
+//    Cost of a candidate: mean press latency (ms) + errorCost * (missed + false
+//    presses) / presses, i.e. with -w 5000 one error per 100 presses costs 50ms.
+//    Search: coordinate descent from the current detection_params.h (default),
+//    or the whole grid with -g.
+//
+//  usage: tune [-g] [-j threads] [-w error cost] [-o detection_params.h] [labeled_trace.txt ...]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include "sampler.h"
+#include "detection.h"
+#include "detection_params.h"
+#include "synth.h"
+#include "trace.h"
+
+static const uint16_t noBaseline[sampleChannels] = {0};
+static const uint32_t tuneMatchUs = 1000000; // Detected later than 1s after the press: missed
+
+// Values tried for each parameter
+static const int tunePressRatios[] = {96, 112, 128, 144, 160, 176};
+static const int tuneReleaseRatios[] = {144, 160, 176, 192, 208, 224};
+static const int tuneDwellSamples[] = {1, 2, 3, 4, 6, 8};
+static const int tuneMinAgeMs[] = {0, 5, 10, 15, 20, 30, 40};
+static const int tuneSlopeQ8[] = {8 << 8, 16 << 8, 32 << 8, 64 << 8};
+static const int tuneReleaseGap = 16; // Hysteresis: release ratio at least press ratio + 16
+
+struct TuneTrace
+{
+    const char *name;
+    std::vector<uint32_t> timeUs;
+    std::vector<int32_t> smoothQ8;           // sampleChannels per sample
+    std::vector<uint32_t> labelUs[sampleChannels]; // Press starts per side, in order
+};
+
+struct TuneScore
+{
+    int presses;
+    int matched;
+    int missed;
+    int falsePresses;
+    uint64_t latencySumUs;
+};
+
+struct TuneCandidate
+{
+    DetectionParams params;
+    TuneScore score;
+    double cost;
+};
+
+static int tuneThreads;
+static double tuneErrorCost = 5000;
+
+// Run fn(0) ... fn(jobs - 1) on the worker threads, each takes the next job when done
+static void tuneParallel(int jobs, const std::function<void(int)> &fn)
+{
+    std::atomic<int> next(0);
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < tuneThreads; i++)
+    {
+        workers.emplace_back([&]() {
+            for (int job = next++; job < jobs; job = next++)
+                fn(job);
+        });
+    }
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+static void tuneAddTrace(std::vector<TuneTrace> &traces, const char *name,
+                         const std::vector<AdcSample> &trace, const std::vector<TraceLabel> &labels)
+{
+    static Detection det;
+    TuneTrace t;
+
+    t.name = name;
+    detectionBegin(det, noBaseline, detectionTuned);
+    t.timeUs.reserve(trace.size());
+    t.smoothQ8.resize(trace.size() * sampleChannels);
+    for (size_t i = 0; i < trace.size(); i++)
+    {
+        t.timeUs.push_back(trace[i].timeUs);
+        detectionSmooth(det, trace[i], &t.smoothQ8[i * sampleChannels]);
+    }
+    for (const TraceLabel &label : labels)
+    {
+        if (label.side >= 0 && label.side < sampleChannels)
+            t.labelUs[label.side].push_back(label.timeUs);
+    }
+    traces.push_back(std::move(t));
+}
+
+// Replay one trace, matching every detected press to the next label on its side
+static void tuneEvaluate(const TuneTrace &t, const DetectionParams &params, TuneScore &score)
+{
+    Detection det{};
+    uint8_t swStatus[sampleChannels] = {0};
+    uint32_t edgeUs[sampleChannels];
+    size_t label[sampleChannels] = {0};
+
+    detectionBegin(det, noBaseline, params);
+    score = TuneScore();
+    for (size_t i = 0; i < t.timeUs.size(); i++)
+    {
+        uint32_t now = t.timeUs[i];
+        uint32_t changed = detectionDecide(det, swStatus, now, &t.smoothQ8[i * sampleChannels], edgeUs);
+        while (changed != 0)
+        {
+            int side = __builtin_ctz(changed);
+            const std::vector<uint32_t> &labels = t.labelUs[side];
+            size_t &k = label[side];
+
+            changed &= changed - 1;
+            if (!swStatus[side])
+                continue; // Release
+            while (k < labels.size() && now - labels[k] > tuneMatchUs && now > labels[k])
+            {
+                score.missed++;
+                k++;
+            }
+            if (k < labels.size() && labels[k] <= now)
+            {
+                score.matched++;
+                score.latencySumUs += now - labels[k];
+                k++;
+            }
+            else
+                score.falsePresses++;
+        }
+    }
+    for (int ch = 0; ch < sampleChannels; ch++)
+    {
+        score.presses += t.labelUs[ch].size();
+        score.missed += t.labelUs[ch].size() - label[ch];
+    }
+}
+
+static double tuneCost(const TuneScore &s)
+{
+    double latencyMs = s.matched ? s.latencySumUs / 1e3 / s.matched : tuneMatchUs / 1e3;
+    return latencyMs + tuneErrorCost * (s.missed + s.falsePresses) / (s.presses ? s.presses : 1);
+}
+
+static bool tuneValid(const DetectionParams &p)
+{
+    return p.releaseRatio >= p.pressRatio + tuneReleaseGap;
+}
+
+// Score every candidate on every trace
+static void tuneRun(const std::vector<TuneTrace> &traces, std::vector<TuneCandidate> &candidates)
+{
+    const int traceCount = traces.size();
+    std::vector<TuneScore> scores(candidates.size() * traceCount);
+
+    tuneParallel(scores.size(), [&](int job) {
+        tuneEvaluate(traces[job % traceCount], candidates[job / traceCount].params, scores[job]);
+    });
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        TuneScore &total = candidates[i].score;
+        total = TuneScore();
+        for (int j = 0; j < traceCount; j++)
+        {
+            const TuneScore &s = scores[i * traceCount + j];
+            total.presses += s.presses;
+            total.matched += s.matched;
+            total.missed += s.missed;
+            total.falsePresses += s.falsePresses;
+            total.latencySumUs += s.latencySumUs;
+        }
+        candidates[i].cost = tuneCost(total);
+    }
+}
+
+static const TuneCandidate &tuneBest(const std::vector<TuneCandidate> &candidates)
+{
+    size_t best = 0;
+
+    for (size_t i = 1; i < candidates.size(); i++)
+    {
+        if (candidates[i].cost < candidates[best].cost)
+            best = i;
+    }
+    return candidates[best];
+}
+
+static TuneCandidate tuneGrid(const std::vector<TuneTrace> &traces, int &evaluations)
+{
+    std::vector<TuneCandidate> candidates;
+
+    for (int press : tunePressRatios)
+        for (int release : tuneReleaseRatios)
+            for (int dwell : tuneDwellSamples)
+                for (int age : tuneMinAgeMs)
+                    for (int slope : tuneSlopeQ8)
+                    {
+                        TuneCandidate c = {};
+                        c.params = {(uint8_t)press, (uint8_t)release, (uint8_t)dwell, (uint8_t)age, slope};
+                        if (tuneValid(c.params))
+                            candidates.push_back(c);
+                    }
+    tuneRun(traces, candidates);
+    evaluations = candidates.size();
+    return tuneBest(candidates);
+}
+
+// Try every value of one parameter at a time with the others fixed, keep the
+// best, until a full round over the parameters changes nothing
+static TuneCandidate tuneDescent(const std::vector<TuneTrace> &traces, int &evaluations)
+{
+    struct Axis
+    {
+        const int *values;
+        int count;
+    };
+    static const Axis axes[] = {
+        {tunePressRatios, sizeof(tunePressRatios) / sizeof(int)},
+        {tuneReleaseRatios, sizeof(tuneReleaseRatios) / sizeof(int)},
+        {tuneDwellSamples, sizeof(tuneDwellSamples) / sizeof(int)},
+        {tuneMinAgeMs, sizeof(tuneMinAgeMs) / sizeof(int)},
+        {tuneSlopeQ8, sizeof(tuneSlopeQ8) / sizeof(int)},
+    };
+    std::vector<TuneCandidate> start(1);
+    TuneCandidate best;
+    bool improved = true;
+
+    start[0].params = detectionTuned;
+    tuneRun(traces, start);
+    best = start[0];
+    evaluations = 1;
+    while (improved)
+    {
+        improved = false;
+        for (int axis = 0; axis < 5; axis++)
+        {
+            std::vector<TuneCandidate> candidates;
+            for (int i = 0; i < axes[axis].count; i++)
+            {
+                TuneCandidate c = best;
+                int v = axes[axis].values[i];
+                switch (axis)
+                {
+                case 0: c.params.pressRatio = v; break;
+                case 1: c.params.releaseRatio = v; break;
+                case 2: c.params.dwellSamples = v; break;
+                case 3: c.params.minAgeMs = v; break;
+                default: c.params.slopeQ8 = v; break;
+                }
+                if (tuneValid(c.params))
+                    candidates.push_back(c);
+            }
+            tuneRun(traces, candidates);
+            evaluations += candidates.size();
+            const TuneCandidate &c = tuneBest(candidates);
+            if (c.cost < best.cost)
+            {
+                best = c;
+                improved = true;
+            }
+        }
+    }
+    return best;
+}
+
+static void tunePrint(FILE *fp, const char *label, const TuneCandidate &c)
+{
+    const TuneScore &s = c.score;
+
+    fprintf(fp, "%s press %d release %d dwell %d age %dms slope %d: %d/%d presses, "
+                "%d missed, %d false, latency %.1f ms, cost %.1f\n",
+            label, c.params.pressRatio, c.params.releaseRatio, c.params.dwellSamples,
+            c.params.minAgeMs, (int)c.params.slopeQ8 >> 8, s.matched, s.presses, s.missed,
+            s.falsePresses, s.matched ? s.latencySumUs / 1e3 / s.matched : 0.0, c.cost);
+}
+
+static bool tuneWriteHeader(const char *path, const TuneCandidate &c, int traceCount)
+{
+    FILE *fp = fopen(path, "w");
+
+    if (fp == NULL)
+        return false;
+    fprintf(fp, "//\n"
+                "//  Detection parameters loaded at start\n"
+                "//    Generated by host/tune from labeled traces (make tune-params); edit by hand only\n"
+                "//    to try a value, the next tuning run overwrites the file.\n"
+                "//    Last run: %d traces, %d/%d presses, %d missed, %d false, latency %.1f ms\n"
+                "//\n"
+                "#pragma once\n\n"
+                "#include \"detection.h\"\n\n"
+                "const DetectionParams detectionTuned = {%d, %d, %d, %d, %d << 8};\n",
+            traceCount, c.score.matched, c.score.presses, c.score.missed, c.score.falsePresses,
+            c.score.matched ? c.score.latencySumUs / 1e3 / c.score.matched : 0.0,
+            c.params.pressRatio, c.params.releaseRatio, c.params.dwellSamples, c.params.minAgeMs,
+            (int)c.params.slopeQ8 >> 8);
+    return fclose(fp) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    bool isGrid = false;
+    const char *outPath = NULL;
+    int evaluations;
+    int opt;
+    std::vector<TuneTrace> traces;
+    std::vector<AdcSample> trace;
+    std::vector<TraceLabel> labels;
+
+    tuneThreads = std::thread::hardware_concurrency();
+    while ((opt = getopt(argc, argv, "gj:w:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'g': isGrid = true; break;
+        case 'j': tuneThreads = atoi(optarg); break;
+        case 'w': tuneErrorCost = atof(optarg); break;
+        case 'o': outPath = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-g] [-j threads] [-w error cost] [-o detection_params.h] "
+                            "[labeled_trace.txt ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (tuneThreads < 1)
+        tuneThreads = 1;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = optind; i < argc; i++)
+    {
+        trace.clear();
+        labels.clear();
+        if (!traceLoad(argv[i], trace) || !traceLoadLabels(argv[i], labels) || labels.empty())
+        {
+            fprintf(stderr, "cannot read %s, or it has no press labels\n", argv[i]);
+            return 1;
+        }
+        tuneAddTrace(traces, argv[i], trace, labels);
+    }
+    if (traces.empty())
+    {
+        std::vector<SynthPress> presses;
+        for (int i = 0; i < synthCorpusSize; i++)
+        {
+            synthSession(synthCorpus[i].params, trace, presses);
+            labels.clear();
+            for (const SynthPress &press : presses)
+                labels.push_back({press.timeUs, press.side});
+            tuneAddTrace(traces, synthCorpus[i].name, trace, labels);
+        }
+    }
+
+    std::vector<TuneCandidate> current(1);
+    current[0].params = detectionTuned;
+    tuneRun(traces, current);
+    TuneCandidate best = isGrid ? tuneGrid(traces, evaluations) : tuneDescent(traces, evaluations);
+    double wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    tunePrint(stdout, "current", current[0]);
+    tunePrint(stdout, "best   ", best);
+    printf("%s search: %d candidates x %zu traces on %d threads in %.1f s\n",
+           isGrid ? "grid" : "descent", evaluations, traces.size(), tuneThreads, wallSec);
+    if (outPath != NULL)
+    {
+        if (!tuneWriteHeader(outPath, best, traces.size()))
+        {
+            fprintf(stderr, "cannot write %s\n", outPath);
+            return 1;
+        }
+        printf("wrote %s\n", outPath);
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+//
+//  Audio cues
+//
+
+#include <stddef.h>
+#include "hal.h"
+#include "timer_sched.h"
+#include "audio_cue.h"
+
+struct CuePattern
+{
+    const CueStep *steps;
+    uint8_t count;
+};
+
+static const CueStep cueRepSteps[] = {{1000, 10, 0}};
+static const CueStep cueRestStartSteps[] = {{1000, 50, 80}};
+static const CueStep cueSetStartSteps[] = {{1000, 50, 80}, {1000, 50, 80}};
+static const CueStep cueSupersetSteps[] = {{1500, 80, 0}};
+static const CueStep cueIntervalSteps[] = {{800, 40, 40}, {1000, 40, 40}, {1300, 80, 0}};
+static const CueStep cueFinishSteps[] = {
+    {1000, 20, 80}, {1000, 20, 80}, {1000, 20, 80}, {1000, 20, 80}, {1000, 20, 80}};
+
+template <uint8_t N>
+constexpr CuePattern makeCue(const CueStep (&steps)[N])
+{
+    return {steps, N};
+}
+
+static const CuePattern cuePatterns[cueItems] = {
+    makeCue(cueRepSteps),       // cueRep
+    makeCue(cueRestStartSteps), // cueRestStart
+    makeCue(cueSetStartSteps),  // cueSetStart
+    makeCue(cueSupersetSteps),  // cueSuperset
+    makeCue(cueIntervalSteps),  // cueInterval
+    makeCue(cueFinishSteps),    // cueFinish
+};
+
+static int cueTimer = -1;
+static const CuePattern *cuePlaying = NULL;
+static AudioCue cuePlayingId = cueRep;
+static uint8_t cueStep = 0;
+static bool cueToneOn = false;
+static uint32_t cueNextUs = 0;    // Deadline of the next step, steps don't drift
+static bool cueMuted = false;     // Volume 0
+
+// Tone on -> tone off -> next step ... on absolute deadlines
+static void cueTimerFired()
+{
+    const CueStep &step = cuePlaying->steps[cueStep];
+
+    if (!cueToneOn)
+    {
+        halSpeakerTone(step.freqHz);
+        cueToneOn = true;
+        cueNextUs += step.onMs * 1000UL;
+    }
+    else
+    {
+        halSpeakerMute();
+        cueToneOn = false;
+        if (++cueStep >= cuePlaying->count)
+        {
+            cuePlaying = NULL;
+            return;
+        }
+        cueNextUs += step.offMs * 1000UL;
+    }
+    schedStartAt(cueTimer, cueNextUs, 0);
+}
+
+void audioCueBegin()
+{
+    halSpeakerBegin();
+    cueTimer = schedCreate("cue", cueTimerFired);
+}
+
+void audioCuePlay(AudioCue cue)
+{
+    if (cueMuted)
+        return;
+    if (cuePlaying != NULL && cuePlayingId > cue)
+        return;
+    if (cueToneOn)
+        halSpeakerMute();
+    cuePlaying = &cuePatterns[cue];
+    cuePlayingId = cue;
+    cueStep = 0;
+    cueToneOn = false;
+    cueNextUs = halMicros();
+    cueTimerFired(); // First tone right away, the rest from the timer
+}
+
+void audioCueStop()
+{
+    schedStop(cueTimer);
+    if (cueToneOn)
+        halSpeakerMute();
+    cueToneOn = false;
+    cuePlaying = NULL;
+}
+
+// Volume 0 skips the cues entirely instead of driving a silent speaker
+void audioCueSetVolume(uint8_t volume)
+{
+    cueMuted = volume == 0;
+    if (cueMuted)
+        audioCueStop();
+    halSpeakerSetVolume(volume);
+}
+
+bool audioCuePlaying()
+{
+    return cuePlaying != NULL;
+}
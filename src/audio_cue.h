@@ -0,0 +1,34 @@
+//
+//  Audio cues
+//    Predefined tone patterns played step by step from a deadline timer
+//    (timer_sched.h), so a cue never blocks the loop.
+//    audioCuePlay() only points the sequencer at the pattern table: O(1).
+//
+#pragma once
+
+#include <stdint.h>
+
+// In priority order: a cue doesn't cut off a playing cue of higher priority
+enum AudioCue
+{
+    cueRep,       // Short click on every counted rep
+    cueRestStart, // Rest time started
+    cueSetStart,  // Next set started
+    cueSuperset,  // Next exercise of a superset, no rest before it
+    cueInterval,  // Timed interval started
+    cueFinish,    // Whole workout finished
+    cueItems
+};
+
+struct CueStep
+{
+    uint16_t freqHz;
+    uint16_t onMs;
+    uint16_t offMs;
+};
+
+void audioCueBegin();
+void audioCuePlay(AudioCue cue);
+void audioCueStop();
+void audioCueSetVolume(uint8_t volume);
+bool audioCuePlaying();
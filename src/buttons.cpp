@@ -0,0 +1,105 @@
+//
+//  Buttons
+//
+
+#include "hal.h"
+#include "spsc_queue.h"
+#include "buttons.h"
+
+struct ButtonEdge
+{
+    uint32_t timeUs;
+    uint8_t button;
+    bool isDown;
+};
+
+// Button as last reported by buttonsNext()
+struct ButtonState
+{
+    bool isDown;
+    uint32_t changeUs;
+    uint32_t nextLongUs; // Held time of the next long press
+};
+
+// Interrupt side
+static SpscQueue<ButtonEdge, 16> buttonEdges;
+static uint32_t buttonEdgeUs[halButtonCount]; // Last accepted edge
+static bool buttonLevels[halButtonCount];     // Read at the last interrupt
+
+// UI side
+static ButtonState buttonStates[halButtonCount];
+
+static void HAL_ISR buttonsEdge(int button, bool isDown)
+{
+    uint32_t now = halMicros();
+
+    // No change: a spurious interrupt (GPIO39 fires on ADC1 reads of GPIO36/35,
+    // ESP32 errata 3.11). It must not wake loop() or start a debounce window.
+    if (isDown == buttonLevels[button])
+        return;
+    buttonLevels[button] = isDown;
+    if (now - buttonEdgeUs[button] < buttonDebounceUs)
+        return; // Bounce
+    buttonEdgeUs[button] = now;
+    buttonEdges.push(ButtonEdge{now, (uint8_t)button, isDown});
+    halWake();
+}
+
+void buttonsBegin()
+{
+    uint32_t now = halMicros();
+
+    // A button held at boot is released first, not reported as a press
+    for (int i = 0; i < halButtonCount; i++)
+    {
+        buttonStates[i] = ButtonState{halButtonDown(i), now, buttonLongPressUs};
+        buttonEdgeUs[i] = now - buttonDebounceUs;
+        buttonLevels[i] = buttonStates[i].isDown;
+    }
+    halButtonsBegin(buttonsEdge);
+}
+
+static void buttonsChange(int button, bool isDown, uint32_t timeUs, ButtonEvent &event)
+{
+    ButtonState &b = buttonStates[button];
+
+    b.isDown = isDown;
+    b.changeUs = timeUs;
+    b.nextLongUs = buttonLongPressUs;
+    event = ButtonEvent{timeUs, (uint8_t)button, isDown ? buttonPress : buttonRelease};
+}
+
+bool buttonsNext(ButtonEvent &event)
+{
+    uint32_t now = halMicros();
+    ButtonEdge edge;
+
+    while (buttonEdges.pop(edge))
+    {
+        if (edge.isDown == buttonStates[edge.button].isDown)
+            continue; // The edge before it was lost in a bounce, already resynced
+        buttonsChange(edge.button, edge.isDown, edge.timeUs, event);
+        return true;
+    }
+
+    for (int i = 0; i < halButtonCount; i++)
+    {
+        ButtonState &b = buttonStates[i];
+        uint32_t heldUs = now - b.changeUs;
+
+        if (heldUs < buttonDebounceUs)
+            continue;
+        if (halButtonDown(i) != b.isDown)
+        {
+            buttonsChange(i, !b.isDown, now, event);
+            return true;
+        }
+        if (b.isDown && heldUs >= b.nextLongUs)
+        {
+            event = ButtonEvent{b.changeUs + b.nextLongUs, (uint8_t)i, buttonLongPress};
+            b.nextLongUs += buttonRepeatUs;
+            return true;
+        }
+    }
+    return false;
+}
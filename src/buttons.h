@@ -0,0 +1,36 @@
+//
+//  Buttons
+//    The GPIO interrupt reports every level change of the three buttons and is
+//    debounced right there: the first edge is taken at once (no added lag),
+//    edges within buttonDebounceUs after it are contact bounce and ignored.
+//    An interrupt that finds the same level as the one before is a glitch
+//    (GPIO39, button A, see buttonsEdge()) and is dropped.
+//    Accepted edges go to a lock-free queue with their time, so a press made
+//    while the UI task draws or beeps is kept, and the interrupt wakes loop()
+//    (halWake()) to handle it now rather than at the next tick.
+//    buttonsNext() turns the edges into events. Once the bounce is over it also
+//    checks the pin level, in case a glitch shorter than the debounce time left
+//    a button looking pressed, and reports a long press when a button is held.
+//
+#pragma once
+
+#include <stdint.h>
+
+const uint32_t buttonDebounceUs = 20000;   // Contact bounce: 20ms
+const uint32_t buttonLongPressUs = 800000; // Held 800ms: first long press
+const uint32_t buttonRepeatUs = 150000;    // Then again every 150ms while held
+
+const uint8_t buttonPress = 1;
+const uint8_t buttonRelease = 2;
+const uint8_t buttonLongPress = 3; // Between buttonPress and buttonRelease, repeats
+
+struct ButtonEvent
+{
+    uint32_t timeUs; // Edge time (halMicros)
+    uint8_t button;  // halButtonA..C
+    uint8_t type;
+};
+
+void buttonsBegin();
+// UI task only. False: no event
+bool buttonsNext(ButtonEvent &event);
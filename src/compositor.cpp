@@ -0,0 +1,120 @@
+//
+//  Compositor
+//
+
+#include "compositor.h"
+
+struct CompositorRegion
+{
+    LGFX_Sprite sprite;
+    int16_t x, y, w, h;
+    int16_t dirtyTop;    // First dirty row (region local)
+    int16_t dirtyBottom; // Last dirty row + 1, dirtyTop >= dirtyBottom means clean
+};
+
+static LovyanGFX *compositorPanel;
+static CompositorRegion compositorRegions[compositorMaxRegions];
+static int compositorRegionNum = 0;
+static CompositorStats compositorStat;
+
+void compositorBegin(LovyanGFX *panel)
+{
+    compositorPanel = panel;
+}
+
+// Returns region id, or -1 if no region / memory is left
+int compositorAddRegion(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+    if (compositorRegionNum >= compositorMaxRegions)
+        return -1;
+
+    CompositorRegion &r = compositorRegions[compositorRegionNum];
+    r.sprite.setColorDepth(16);
+    if (r.sprite.createSprite(w, h) == NULL)
+        return -1;
+    r.x = x;
+    r.y = y;
+    r.w = w;
+    r.h = h;
+    r.dirtyTop = h;
+    r.dirtyBottom = 0;
+    return compositorRegionNum++;
+}
+
+// Sprite to draw into, in region local coordinates
+LGFX_Sprite &compositorCanvas(int region)
+{
+    compositorPanel->waitDMA(); // The previous push may still read the sprite
+    return compositorRegions[region].sprite;
+}
+
+void compositorMarkDirty(int region, int16_t y, int16_t h)
+{
+    CompositorRegion &r = compositorRegions[region];
+
+    if (y < 0)
+    {
+        h += y;
+        y = 0;
+    }
+    if (y + h > r.h)
+        h = r.h - y;
+    if (h <= 0)
+        return;
+    if (y < r.dirtyTop)
+        r.dirtyTop = y;
+    if (y + h > r.dirtyBottom)
+        r.dirtyBottom = y + h;
+}
+
+void compositorMarkDirty(int region)
+{
+    compositorMarkDirty(region, 0, compositorRegions[region].h);
+}
+
+// Forget pending pushes, e.g. after the whole screen was cleared
+void compositorHideAll()
+{
+    for (int i = 0; i < compositorRegionNum; i++)
+    {
+        compositorRegions[i].dirtyTop = compositorRegions[i].h;
+        compositorRegions[i].dirtyBottom = 0;
+    }
+}
+
+// Dirty areas are tracked as row spans. Full sprite rows are contiguous in memory,
+// so every span goes out as one DMA transfer.
+void compositorFlush()
+{
+    uint32_t pixels = 0;
+
+    for (int i = 0; i < compositorRegionNum; i++)
+    {
+        CompositorRegion &r = compositorRegions[i];
+        if (r.dirtyTop >= r.dirtyBottom)
+            continue;
+
+        if (pixels == 0)
+            compositorPanel->startWrite();
+        const lgfx::swap565_t *buf = (const lgfx::swap565_t *)r.sprite.getBuffer();
+        int16_t rows = r.dirtyBottom - r.dirtyTop;
+        compositorPanel->pushImageDMA(r.x, r.y + r.dirtyTop, r.w, rows, buf + r.dirtyTop * r.w);
+        pixels += (uint32_t)r.w * rows;
+        r.dirtyTop = r.h;
+        r.dirtyBottom = 0;
+    }
+    if (pixels == 0)
+        return;
+    compositorPanel->endWrite();
+
+    compositorStat.frames++;
+    compositorStat.pixels += pixels;
+    compositorStat.bytes += pixels * 2;
+    compositorStat.lastFramePixels = pixels;
+    compositorStat.lastFrameBytes = pixels * 2;
+}
+
+const CompositorStats &compositorStats()
+{
+    return compositorStat;
+}
@@ -0,0 +1,29 @@
+//
+//  Compositor
+//    Off-screen sprite regions on top of the panel. Screens draw into a region
+//    and mark it dirty; compositorFlush() pushes only the dirty rows of each
+//    region, over DMA, once per scheduler tick.
+//
+#pragma once
+
+#include "M5GFX.h"
+
+const int compositorMaxRegions = 8;
+
+struct CompositorStats
+{
+    uint32_t frames;          // Flushes that pushed something
+    uint32_t pixels;          // Total pixels pushed
+    uint32_t bytes;           // Total bytes pushed (RGB565)
+    uint32_t lastFramePixels; // Pixels pushed by the last flush
+    uint32_t lastFrameBytes;
+};
+
+void compositorBegin(LovyanGFX *panel);
+int compositorAddRegion(int16_t x, int16_t y, int16_t w, int16_t h);
+LGFX_Sprite &compositorCanvas(int region);
+void compositorMarkDirty(int region, int16_t y, int16_t h);
+void compositorMarkDirty(int region);
+void compositorHideAll();
+void compositorFlush();
+const CompositorStats &compositorStats();
@@ -0,0 +1,96 @@
+//
+//  Rep detection
+//
+
+#include "sampler.h"
+#include "detector.h"
+#include "filter_chain.h"
+#include "detection.h"
+
+// storedBaseline: see detectorBegin()
+void detectionBegin(Detection &det, const uint16_t *storedBaseline, const DetectionParams &params)
+{
+    detectorBegin(det.detector, storedBaseline);
+    detectorSetRatios(det.detector, params.pressRatio, params.releaseRatio);
+    det.params = params;
+    det.isFilterStarted = false; // Filters restart from the next sample
+    det.isSlopeStarted = false;  // and the slope history from the next decision
+    for (int ch = 0; ch < sampleChannels; ch++)
+    {
+        det.stable[ch] = 0;
+        det.edgeUs[ch] = 0;
+    }
+}
+
+// Sample -> median (spikes) -> low-pass (noise). Depends on no DetectionParams,
+// so the host tuner runs it once per trace and only repeats detectionDecide().
+void detectionSmooth(Detection &det, const AdcSample &sample, int32_t smoothQ8[sampleChannels])
+{
+    uint16_t median[sampleChannels];
+
+    if (!det.isFilterStarted)
+    {
+        det.median.reset(sample.value);
+        det.lowPass.reset(sample.value);
+        det.isFilterStarted = true;
+    }
+    det.median.process(sample.value, median);
+    det.lowPass.process(median, smoothQ8);
+}
+
+// Thresholds following the baseline (detector.h) -> status change after
+// params.dwellSamples agreeing samples.
+// Returns bit mask of the channels (bit0:Right, bit1:Left, ...) whose status changed.
+// edgeUs of a changed channel is where the steep part of the change started
+// (SlopeTracker), so neither the filters nor the dwell shift the event time.
+uint32_t detectionDecide(Detection &det, uint8_t swStatus[sampleChannels], uint32_t timeUs,
+                         const int32_t smoothQ8[sampleChannels], uint32_t edgeUs[sampleChannels])
+{
+    uint16_t smooth[sampleChannels];
+    int8_t direction[sampleChannels];
+    uint8_t pressed[sampleChannels];
+    uint32_t minAgeUs = det.params.minAgeMs * 1000;
+    uint32_t changed = 0;
+
+    for (int ch = 0; ch < sampleChannels; ch++)
+    {
+        smooth[ch] = smoothQ8[ch] >> 8;
+        direction[ch] = swStatus[ch] * 2 - 1; // Pressed: watch for the rise of a release
+    }
+    // Restarted here, not with the filters: the tuner smooths a trace once and
+    // decides it many times over
+    if (!det.isSlopeStarted)
+    {
+        det.slope.reset(smoothQ8, timeUs);
+        det.isSlopeStarted = true;
+    }
+    det.slope.process(smoothQ8, direction, det.params.slopeQ8, timeUs);
+    detectorUpdate(det.detector, smooth, pressed);
+
+    for (int ch = 0; ch < sampleChannels; ch++)
+    {
+        uint32_t differs = pressed[ch] ^ swStatus[ch];
+        uint32_t stable = (det.stable[ch] + 1) * differs;     // 0 when they agree
+        uint32_t runStart = -(uint32_t)(stable == 1);         // ~0 on the first differing sample
+        uint32_t flip;
+
+        det.edgeUs[ch] = (det.slope.onsetUs(ch) & runStart) | (det.edgeUs[ch] & ~runStart);
+        flip = (stable >= det.params.dwellSamples) & (timeUs - det.edgeUs[ch] >= minAgeUs);
+
+        edgeUs[ch] = det.edgeUs[ch];
+        swStatus[ch] ^= flip;
+        det.stable[ch] = stable * (flip ^ 1);
+        changed |= flip << ch;
+    }
+    return changed;
+}
+
+// Update the switch status with one sample of every channel, all the stages above
+uint32_t checkSwichStatus(Detection &det, uint8_t swStatus[sampleChannels], const AdcSample &sample,
+                          uint32_t edgeUs[sampleChannels])
+{
+    int32_t smoothQ8[sampleChannels];
+
+    detectionSmooth(det, sample, smoothQ8);
+    return detectionDecide(det, swStatus, sample.timeUs, smoothQ8, edgeUs);
+}
@@ -0,0 +1,50 @@
+//
+//  Rep detection
+//    Filtering, thresholding and chattering removal on top of the sampler,
+//    all channels of a sample in one pass, sample by sample.
+//    No display / speaker access here so the same code runs on the host replay.
+//    All state is in a Detection, the firmware runs sensorDetection (sensor_task.h).
+//
+#pragma once
+
+#include <stdint.h>
+#include "sampler.h"
+#include "detector.h"
+#include "filter_chain.h"
+
+const uint32_t swReadInterval = 10; // Screen update / rep event read interval: 10ms
+
+//---- Filter chain (filter_chain.h), fixed at compile time. 1 sample = 1ms at 1kHz
+const int filterMedianTaps = 5;            // Drops spikes up to 2 samples long
+const int filterLowPassShift = 2;          // Time constant 4 samples
+const int filterSlopeSpan = 4;             // Slope over 4 samples
+
+//---- Decision, set at run time. Values: detection_params.h (host/tune)
+struct DetectionParams
+{
+    uint8_t pressRatio;   // Pressed below baseline * pressRatio/256
+    uint8_t releaseRatio; // Released above baseline * releaseRatio/256
+    uint8_t dwellSamples; // Filtered status must agree for this many samples
+    uint8_t minAgeMs;     // and the change must have started this long ago
+    int32_t slopeQ8;      // Slope (Q8 over filterSlopeSpan samples) of a press or release under way
+};
+
+struct Detection
+{
+    MedianFilter<filterMedianTaps> median;
+    LowPassFilter<filterLowPassShift> lowPass;
+    SlopeTracker<filterSlopeSpan> slope;
+    Detector detector;
+    DetectionParams params;
+    bool isFilterStarted;
+    bool isSlopeStarted;
+    uint8_t stable[sampleChannels]; // Consecutive samples that differ from current status
+    uint32_t edgeUs[sampleChannels]; // Onset of the change that run belongs to
+};
+
+void detectionBegin(Detection &det, const uint16_t *storedBaseline, const DetectionParams &params);
+void detectionSmooth(Detection &det, const AdcSample &sample, int32_t smoothQ8[sampleChannels]);
+uint32_t detectionDecide(Detection &det, uint8_t swStatus[sampleChannels], uint32_t timeUs,
+                         const int32_t smoothQ8[sampleChannels], uint32_t edgeUs[sampleChannels]);
+uint32_t checkSwichStatus(Detection &det, uint8_t swStatus[sampleChannels], const AdcSample &sample,
+                          uint32_t edgeUs[sampleChannels]);
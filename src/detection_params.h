@@ -0,0 +1,12 @@
+//
+//  Detection parameters loaded at start
+//    Hand-set: the values the detector had before they became parameters.
+//    Not tuned yet, the synthetic corpus alone pushes the ratios to the edge of
+//    the grid. Run host/tune on recorded traces (./tune -o ../src/detection_params.h
+//    session.txt ...); it overwrites this file with the result.
+//
+#pragma once
+
+#include "detection.h"
+
+const DetectionParams detectionTuned = {128, 168, 3, 20, 32 << 8};
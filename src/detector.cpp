@@ -0,0 +1,107 @@
+//
+//  Adaptive threshold detector
+//    Per-channel state is kept as one array per field (structure of arrays),
+//    and detectorUpdate() runs the same branch-free steps over all channels of
+//    a sample, so the cost is linear in the number of channels.
+//
+
+#include "detector.h"
+
+static void detectorSetThresholds(Detector &det, int ch)
+{
+    uint32_t baseline = det.baselineQ8[ch] >> 8;
+
+    det.pressThreshold[ch] = baseline * det.pressRatio >> 8;
+    det.releaseThreshold[ch] = baseline * det.releaseRatio >> 8;
+}
+
+// storedBaseline: baseline saved by the last calibration (0: none)
+void detectorBegin(Detector &det, const uint16_t *storedBaseline)
+{
+    det.pressRatio = detectorPressRatio;
+    det.releaseRatio = detectorReleaseRatio;
+    for (int ch = 0; ch < sampleChannels; ch++)
+    {
+        uint16_t baseline = storedBaseline[ch] ? storedBaseline[ch] : detectorDefaultBaseline;
+        det.baselineQ8[ch] = (uint32_t)baseline << 8;
+        detectorSetThresholds(det, ch);
+        det.pressed[ch] = 0;
+        det.calSum[ch] = 0;
+        det.calMin[ch] = 0xffff;
+        det.calMax[ch] = 0;
+    }
+    det.calCount = 0;
+    det.calDone = false;
+}
+
+void detectorSetRatios(Detector &det, uint8_t pressRatio, uint8_t releaseRatio)
+{
+    det.pressRatio = pressRatio;
+    det.releaseRatio = releaseRatio;
+    for (int ch = 0; ch < sampleChannels; ch++)
+        detectorSetThresholds(det, ch);
+}
+
+// Average the first samples as the baseline. If a sensor moved too much
+// (somebody already on the pad), the previous baseline is kept for that sensor.
+static void detectorCalibrate(Detector &det, const uint16_t *adcVal)
+{
+    for (int ch = 0; ch < sampleChannels; ch++)
+    {
+        det.calSum[ch] += adcVal[ch];
+        if (adcVal[ch] < det.calMin[ch])
+            det.calMin[ch] = adcVal[ch];
+        if (adcVal[ch] > det.calMax[ch])
+            det.calMax[ch] = adcVal[ch];
+    }
+    if (++det.calCount < detectorCalibrationSamples)
+        return;
+
+    for (int ch = 0; ch < sampleChannels; ch++)
+    {
+        if (det.calMax[ch] - det.calMin[ch] > detectorCalibrationSpread)
+            continue;
+        det.baselineQ8[ch] = (det.calSum[ch] / detectorCalibrationSamples) << 8;
+        detectorSetThresholds(det, ch);
+    }
+    det.calDone = true;
+}
+
+// One sample of every channel. pressed[ch]: 1 while pressed
+void detectorUpdate(Detector &det, const uint16_t *adcVal, uint8_t *pressed)
+{
+    if (!det.calDone)
+    {
+        detectorCalibrate(det, adcVal);
+        for (int ch = 0; ch < sampleChannels; ch++)
+            pressed[ch] = 0;
+        return;
+    }
+
+    for (int ch = 0; ch < sampleChannels; ch++)
+    {
+        uint32_t v = adcVal[ch];
+        uint32_t wasPressed = det.pressed[ch];
+        // Pressed stays until above the release threshold, released until below the press one
+        uint32_t isPressed = (wasPressed & (v <= det.releaseThreshold[ch])) |
+                             (~wasPressed & 1 & (v < det.pressThreshold[ch]));
+        // Follow slow drift (foam, temperature) only while clearly idle: mask is 0 or ~0
+        int32_t idleMask = -(int32_t)(~isPressed & 1 & (v > det.releaseThreshold[ch]));
+        int32_t step = (((int32_t)v << 8) - (int32_t)det.baselineQ8[ch]) >> detectorBaselineShift;
+
+        det.baselineQ8[ch] += step & idleMask;
+        detectorSetThresholds(det, ch);
+        det.pressed[ch] = isPressed;
+        pressed[ch] = isPressed;
+    }
+}
+
+bool detectorCalibrated(const Detector &det)
+{
+    return det.calDone;
+}
+
+uint16_t detectorBaseline(const Detector &det, int ch)
+{
+    return det.baselineQ8[ch] >> 8;
+}
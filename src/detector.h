@@ -0,0 +1,41 @@
+//
+//  Adaptive threshold detector
+//    Tracks the idle level (baseline) of each sensor and decides pressed / released
+//    with separate thresholds relative to it (hysteresis).
+//    The FSR is pulled up, so the ADC value goes down when it is pressed.
+//    Integer only, constant time per sample and channel.
+//    State lives in a Detector so the host tools can run several side by side.
+//
+#pragma once
+
+#include <stdint.h>
+#include "sampler.h"
+
+const uint8_t detectorPressRatio = 128;       // Default: pressed below baseline * 128/256
+const uint8_t detectorReleaseRatio = 168;     // Default: released above baseline * 168/256
+const uint8_t detectorBaselineShift = 10;     // Baseline follows with 1/1024 per sample (~1s)
+const uint16_t detectorCalibrationSamples = 500; // 0.5s at 1kHz
+const uint16_t detectorCalibrationSpread = 256;  // Max min/max spread accepted as idle
+const uint16_t detectorDefaultBaseline = 4000;
+
+// One array per field over the channels (structure of arrays)
+struct Detector
+{
+    uint32_t baselineQ8[sampleChannels]; // Idle level, Q24.8
+    uint16_t pressThreshold[sampleChannels];
+    uint16_t releaseThreshold[sampleChannels];
+    uint8_t pressed[sampleChannels];
+    uint32_t calSum[sampleChannels];     // Calibration accumulators
+    uint16_t calMin[sampleChannels];
+    uint16_t calMax[sampleChannels];
+    uint16_t calCount;
+    bool calDone;
+    uint8_t pressRatio;
+    uint8_t releaseRatio;
+};
+
+void detectorBegin(Detector &det, const uint16_t *storedBaseline);
+void detectorSetRatios(Detector &det, uint8_t pressRatio, uint8_t releaseRatio);
+void detectorUpdate(Detector &det, const uint16_t *adcVal, uint8_t *pressed);
+bool detectorCalibrated(const Detector &det);
+uint16_t detectorBaseline(const Detector &det, int ch);
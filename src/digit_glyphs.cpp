@@ -0,0 +1,55 @@
+//
+//  Digit glyph cache
+//
+
+#include "digit_glyphs.h"
+
+static LGFX_Sprite digitGlyph[10];
+static int32_t digitWidth[10];
+static bool digitReady = false;
+
+// Rasterize '0' .. '9' with the font / size of the counters
+bool digitGlyphsBegin(LovyanGFX *ref, int font, float size)
+{
+    char text[2] = {0, 0};
+
+    ref->setTextFont(font);
+    ref->setTextSize(size);
+    for (int d = 0; d < 10; d++)
+    {
+        text[0] = '0' + d;
+        digitWidth[d] = ref->textWidth(text);
+
+        LGFX_Sprite &g = digitGlyph[d];
+        g.setColorDepth(1);
+        if (g.createSprite(digitWidth[d], ref->fontHeight()) == NULL)
+            return false;
+        g.setTextFont(font);
+        g.setTextSize(size);
+        g.setTextColor(1, 0);
+        g.fillScreen(0);
+        g.drawString(text, 0, 0);
+    }
+    digitReady = true;
+    return true;
+}
+
+// Draw value right aligned at rightX. Returns the left end of the drawn digits.
+int32_t drawDigits(LGFX_Sprite &canvas, uint32_t value, int32_t rightX, int32_t y,
+                   uint16_t fgColor, uint16_t bgColor)
+{
+    int32_t x = rightX;
+
+    if (!digitReady)
+        return x;
+    do
+    {
+        LGFX_Sprite &g = digitGlyph[value % 10];
+        x -= digitWidth[value % 10];
+        g.setPaletteColor(0, bgColor);
+        g.setPaletteColor(1, fgColor);
+        g.pushSprite(&canvas, x, y);
+        value /= 10;
+    } while (value != 0);
+    return x;
+}
@@ -0,0 +1,14 @@
+//
+//  Digit glyph cache
+//    The big rep / rest counters are drawn from digits rasterized once at boot
+//    into 1 bit sprites. Updating a counter is a few sprite blits with the
+//    foreground / background colors set in the palette, no text rendering and
+//    no heap allocation.
+//
+#pragma once
+
+#include "M5GFX.h"
+
+bool digitGlyphsBegin(LovyanGFX *ref, int font, float size);
+int32_t drawDigits(LGFX_Sprite &canvas, uint32_t value, int32_t rightX, int32_t y,
+                   uint16_t fgColor, uint16_t bgColor);
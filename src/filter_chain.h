@@ -0,0 +1,116 @@
+//
+//  Streaming sensor filters
+//    Integer fixed-point stages run per sample over all channels, state kept
+//    one array per field. Coefficients are template parameters, so every
+//    divide is a shift and the loops have no per-channel branches.
+//      MedianFilter<Taps>      spike removal, delay (Taps - 1) / 2 samples
+//      LowPassFilter<Shift>    single pole IIR, y += (x - y) / 2^Shift
+//      SlopeTracker<Span>      start time of the current steep run (onset)
+//
+#pragma once
+
+#include <stdint.h>
+#include "sampler.h"
+
+template <int Taps>
+class MedianFilter
+{
+    static_assert(Taps % 2 == 1 && Taps <= 9, "Median needs an odd, small window");
+
+public:
+    void reset(const uint16_t *x)
+    {
+        for (int i = 0; i < Taps; i++)
+            for (int ch = 0; ch < sampleChannels; ch++)
+                hist_[i][ch] = x[ch];
+        pos_ = 0;
+    }
+
+    // The median is the value with Taps / 2 values ranked below it (ties by age)
+    void process(const uint16_t *in, uint16_t *out)
+    {
+        for (int ch = 0; ch < sampleChannels; ch++)
+            hist_[pos_][ch] = in[ch];
+        pos_ = pos_ + 1 == Taps ? 0 : pos_ + 1;
+
+        for (int ch = 0; ch < sampleChannels; ch++)
+        {
+            uint32_t median = 0;
+            for (int i = 0; i < Taps; i++)
+            {
+                uint32_t rank = 0;
+                for (int j = 0; j < Taps; j++)
+                    rank += (hist_[j][ch] < hist_[i][ch]) | ((hist_[j][ch] == hist_[i][ch]) & (j < i));
+                median |= hist_[i][ch] & -(uint32_t)(rank == Taps / 2);
+            }
+            out[ch] = median;
+        }
+    }
+
+private:
+    uint16_t hist_[Taps][sampleChannels];
+    uint8_t pos_;
+};
+
+template <int Shift>
+class LowPassFilter
+{
+public:
+    void reset(const uint16_t *x)
+    {
+        for (int ch = 0; ch < sampleChannels; ch++)
+            yQ8_[ch] = (int32_t)x[ch] << 8;
+    }
+
+    // out: filtered value in Q8 (1/256 ADC count)
+    void process(const uint16_t *in, int32_t *outQ8)
+    {
+        for (int ch = 0; ch < sampleChannels; ch++)
+        {
+            yQ8_[ch] += (((int32_t)in[ch] << 8) - yQ8_[ch]) >> Shift;
+            outQ8[ch] = yQ8_[ch];
+        }
+    }
+
+private:
+    int32_t yQ8_[sampleChannels];
+};
+
+// Slope is the change over the last Span samples (Q8), steep when above thresholdQ8.
+// direction[ch]: -1 to watch for a falling run (press), +1 for a rising run (release)
+template <int Span>
+class SlopeTracker
+{
+    static_assert((Span & (Span - 1)) == 0, "Span must be power of 2");
+
+public:
+    void reset(const int32_t *xQ8, uint32_t nowUs)
+    {
+        for (int i = 0; i < Span; i++)
+            for (int ch = 0; ch < sampleChannels; ch++)
+                histQ8_[i][ch] = xQ8[ch];
+        for (int ch = 0; ch < sampleChannels; ch++)
+            onsetUs_[ch] = nowUs;
+        pos_ = 0;
+    }
+
+    void process(const int32_t *xQ8, const int8_t *direction, int32_t thresholdQ8, uint32_t nowUs)
+    {
+        for (int ch = 0; ch < sampleChannels; ch++)
+        {
+            int32_t slope = (xQ8[ch] - histQ8_[pos_][ch]) * direction[ch];
+            uint32_t flat = -(uint32_t)(slope <= thresholdQ8); // ~0: not in a steep run
+            onsetUs_[ch] = (nowUs & flat) | (onsetUs_[ch] & ~flat);
+            histQ8_[pos_][ch] = xQ8[ch];
+        }
+        pos_ = (pos_ + 1) & (Span - 1);
+    }
+
+    // Time the current steep run started, now if there is none
+    uint32_t onsetUs(int ch) const { return onsetUs_[ch]; }
+
+private:
+    int32_t histQ8_[Span][sampleChannels];
+    uint32_t onsetUs_[sampleChannels];
+    uint8_t pos_;
+};
@@ -0,0 +1,148 @@
+//
+//  Font cache
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <Arduino.h>
+#include "hal.h"
+#include "font_cache.h"
+
+static const char *const fontPaths[fontCacheFonts] = {
+    "/euro_b_20.vlw", // fontButton
+};
+
+struct FontCell
+{
+    int8_t font;  // -1: empty
+    uint16_t fgColor;
+    uint16_t bgColor;
+    int16_t w;
+    int16_t h;
+    uint32_t lastUse;
+    char text[fontCacheTextMax];
+    uint16_t *pixels; // As the sprite stores them (byte swapped RGB565)
+};
+
+static uint8_t *fontData[fontCacheFonts];
+static FontCell fontCells[fontCacheCells];
+static uint32_t fontUseCount;
+static LGFX_Sprite fontRenderer; // Cells are drawn here, holds the font last used
+static int fontRendererFont = -1;
+static FontCacheStats fontStats;
+
+// PSRAM when the board has it
+static void *fontAlloc(size_t size)
+{
+    void *p = ps_malloc(size);
+
+    return p != NULL ? p : malloc(size);
+}
+
+bool fontCacheBegin()
+{
+    bool isLoaded = false;
+
+    for (int i = 0; i < fontCacheFonts; i++)
+    {
+        uint32_t size = halFileSize(fontPaths[i]);
+        if (size == 0 || (fontData[i] = (uint8_t *)fontAlloc(size)) == NULL)
+            continue;
+        if (!halFileRead(fontPaths[i], 0, fontData[i], size))
+        {
+            free(fontData[i]);
+            fontData[i] = NULL;
+            continue;
+        }
+        fontStats.fontBytes += size;
+        isLoaded = true;
+    }
+    if (!isLoaded)
+        return false;
+
+    for (int i = 0; i < fontCacheCells; i++)
+    {
+        fontCells[i].font = -1;
+        fontCells[i].pixels = (uint16_t *)fontAlloc(fontCacheCellPixels * sizeof(uint16_t));
+    }
+    return true;
+}
+
+static void fontDrawBuiltin(LGFX_Sprite &canvas, const char *text, uint16_t fgColor, uint16_t bgColor)
+{
+    canvas.fillScreen(bgColor);
+    canvas.setTextFont(4);
+    canvas.setTextSize(1);
+    canvas.setTextColor(fgColor);
+    canvas.drawCenterString(text, canvas.width() / 2, 3);
+}
+
+// Render into fontRenderer, sized as the canvas
+static bool fontRender(int font, int16_t w, int16_t h, const char *text, uint16_t fgColor, uint16_t bgColor)
+{
+    if (fontRenderer.width() != w || fontRenderer.height() != h)
+    {
+        fontRenderer.deleteSprite();
+        fontRendererFont = -1;
+        if (fontRenderer.createSprite(w, h) == NULL)
+            return false;
+    }
+    if (fontRendererFont != font)
+    {
+        if (!fontRenderer.loadFont(fontData[font])) // Parses the glyph table, the bitmaps stay in place
+            return false;
+        fontRendererFont = font;
+    }
+    fontRenderer.fillScreen(bgColor);
+    fontRenderer.setTextColor(fgColor, bgColor);
+    fontRenderer.drawCenterString(text, w / 2, (h - fontRenderer.fontHeight()) / 2);
+    return true;
+}
+
+void fontCacheDrawCell(LGFX_Sprite &canvas, int font, const char *text, uint16_t fgColor, uint16_t bgColor)
+{
+    int16_t w = canvas.width();
+    int16_t h = canvas.height();
+    size_t bytes = w * h * sizeof(uint16_t);
+    bool isCacheable = w * h <= fontCacheCellPixels && strlen(text) < fontCacheTextMax;
+    FontCell *cell = &fontCells[0];
+
+    if (fontData[font] == NULL)
+    {
+        fontDrawBuiltin(canvas, text, fgColor, bgColor);
+        return;
+    }
+    fontUseCount++;
+    for (int i = 0; isCacheable && i < fontCacheCells; i++)
+    {
+        FontCell &c = fontCells[i];
+        if (c.font == font && c.fgColor == fgColor && c.bgColor == bgColor && c.w == w && c.h == h &&
+            strcmp(c.text, text) == 0)
+        {
+            c.lastUse = fontUseCount;
+            fontStats.hits++;
+            memcpy(canvas.getBuffer(), c.pixels, bytes);
+            return;
+        }
+        if (c.lastUse < cell->lastUse)
+            cell = &c; // Least recently used, empty cells first (0)
+    }
+
+    fontStats.misses++;
+    if (!fontRender(font, w, h, text, fgColor, bgColor))
+    {
+        fontDrawBuiltin(canvas, text, fgColor, bgColor);
+        return;
+    }
+    memcpy(canvas.getBuffer(), fontRenderer.getBuffer(), bytes);
+    if (!isCacheable || cell->pixels == NULL)
+        return;
+    *cell = FontCell{(int8_t)font, fgColor, bgColor, w, h, fontUseCount, {0}, cell->pixels};
+    strcpy(cell->text, text);
+    memcpy(cell->pixels, fontRenderer.getBuffer(), bytes);
+}
+
+const FontCacheStats &fontCacheStats()
+{
+    return fontStats;
+}
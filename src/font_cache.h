@@ -0,0 +1,32 @@
+//
+//  Font cache
+//    VLW fonts are read from the SD card root once at boot, into PSRAM (heap on
+//    boards without it), and given to M5GFX as memory fonts: glyphs are read in
+//    place, the card is never touched while drawing.
+//    VLW text is anti-aliased and slower to draw than the built-in bitmap fonts,
+//    so each rendered cell (text centered on its background) is kept in a small
+//    LRU cache; drawing it again is one copy into the canvas.
+//    A font whose file is missing falls back to the built-in font 4.
+//
+#pragma once
+
+#include "M5GFX.h"
+
+const int fontButton = 0;                  // Button labels
+const int fontCacheFonts = 1;
+const int fontCacheCells = 8;              // Rendered cells kept
+const int fontCacheCellPixels = 84 * 27;   // Largest cell: a button
+const int fontCacheTextMax = 16;           // Longer text is drawn every time
+
+struct FontCacheStats
+{
+    uint32_t fontBytes; // Loaded font files
+    uint32_t hits;
+    uint32_t misses;
+};
+
+// After M5.begin() (SD card mounted). False: no font file found
+bool fontCacheBegin();
+// Fill the whole canvas (16 bit) with bg and draw text centered in it
+void fontCacheDrawCell(LGFX_Sprite &canvas, int font, const char *text, uint16_t fgColor, uint16_t bgColor);
+const FontCacheStats &fontCacheStats();
@@ -0,0 +1,96 @@
+//
+//  Hardware abstraction
+//    Thin layer over the M5Stack / ESP32 peripherals used by the training logic.
+//    Drawing stays on M5GFX in main.cpp; nothing below the screens draws.
+//    hal_m5stack.cpp implements it on the device, host/hal_host.cpp on Linux
+//    (virtual clock + recorded ADC traces) so the logic can be replayed off-device.
+//
+#pragma once
+
+#include <stdint.h>
+
+// Code reached from an interrupt has to be in IRAM on the ESP32: the flash
+// cache is off while the settings region is written
+#ifdef ARDUINO
+#include "esp_attr.h"
+#define HAL_ISR IRAM_ATTR
+#else
+#define HAL_ISR
+#endif
+
+//---- Board
+void halBegin();
+
+//---- Clock
+uint32_t halMicros();
+uint32_t halMillis();
+void halDelay(uint32_t ms);
+// Sleep of loop(), ended early by halWake() (from an interrupt). True: woken
+bool halSleepUs(uint32_t us);
+void halWake();
+
+//---- ADC
+void halAdcBegin(const uint16_t *pins, int count);
+uint16_t halAdcRead(int ch);
+
+//---- Periodic timer (callback runs outside of loop())
+void halTimerStartPeriodic(uint32_t periodUs, void (*callback)());
+
+//---- Task pinned to a core, calls fn every periodMs
+void halTaskStartPeriodic(const char *name, void (*fn)(), uint32_t periodMs, int core);
+// Stack bytes never used so far by a task started above (NULL: the calling task)
+uint32_t halTaskStackFree(const char *name);
+
+//---- Profiling
+uint32_t halCycleCount(); // Free running, wraps
+uint32_t halCyclesPerUs();
+
+//---- Serial, binary output (text goes through Serial.print as before)
+uint32_t halSerialWritable(); // Bytes that fit the TX buffer without blocking
+void halSerialWrite(const uint8_t *data, uint32_t len);
+
+//---- Datagram link to the wireless sensor node (WiFi UDP on the device)
+// The device is the access point the node joins. Never blocks.
+bool halLinkBegin(const char *ssid, const char *password, uint16_t port);
+bool halLinkSend(const uint8_t *data, uint32_t len); // To where the last datagram came from
+uint32_t halLinkReceive(uint8_t *buf, uint32_t size); // One datagram, 0: none
+
+//---- Storage (microSD), files by absolute path
+bool halStorageBegin(const char *dir); // Card mounted, dir created if missing
+uint32_t halFileSize(const char *path); // 0: no file
+bool halFileRead(const char *path, uint32_t offset, void *buf, uint32_t len);
+// Creates the file. Writing past the end leaves a gap that reads as 0.
+bool halFileWrite(const char *path, uint32_t offset, const void *data, uint32_t len);
+
+//---- Wall clock, set over Serial (no RTC on the board)
+uint32_t halEpochSeconds(); // 0: not set
+void halSetEpochSeconds(uint32_t sec);
+
+//---- Speaker
+void halSpeakerBegin();
+void halSpeakerTone(uint16_t freqHz); // Until halSpeakerMute()
+void halSpeakerMute();
+void halSpeakerSetVolume(uint8_t volume);
+
+//---- Buttons (GPIO 39 / 38 / 37)
+const int halButtonA = 0;
+const int halButtonB = 1;
+const int halButtonC = 2;
+const int halButtonCount = 3;
+// onEdge(button, isDown) runs in the GPIO interrupt at every level change
+void halButtonsBegin(void (*onEdge)(int button, bool isDown));
+bool halButtonDown(int button);
+
+//---- Settings flash region
+// halFlashBegin() returns the region size (0: none) and sets the erase unit.
+// Writes may only clear bits; erased bytes read 0xff.
+uint32_t halFlashBegin(uint32_t &sectorSize);
+bool halFlashRead(uint32_t offset, void *buf, uint32_t len);
+bool halFlashWrite(uint32_t offset, const void *buf, uint32_t len);
+bool halFlashErase(uint32_t offset, uint32_t len);
+
+//---- EEPROM (legacy 8 byte settings block)
+void halEepromBegin(int size);
+uint8_t halEepromRead(int addr);
+void halEepromWrite(int addr, uint8_t value);
+void halEepromCommit();
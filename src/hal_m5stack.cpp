@@ -0,0 +1,431 @@
+//
+//  Hardware abstraction: M5Stack (ESP32) implementation
+//
+
+#include "M5Stack.h"
+#include "EEPROM.h"
+#include "WiFi.h"
+#include "WiFiUdp.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "nvs.h"
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "hal.h"
+
+static esp_timer_handle_t halTimer;
+static const uint16_t *halAdcPins;
+static const uint8_t halButtonPins[halButtonCount] = {39, 38, 37}; // Low while pressed
+static void (*halButtonEdge)(int button, bool isDown);
+static TaskHandle_t halSleeper; // loop() task, woken by halWake()
+static WiFiUDP halLinkUdp;
+static IPAddress halLinkPeer;
+static uint16_t halLinkPeerPort = 0; // 0: nothing received yet
+
+void halBegin()
+{
+    M5.begin();
+}
+
+uint32_t HAL_ISR halMicros()
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+uint32_t halMillis()
+{
+    return millis();
+}
+
+void halDelay(uint32_t ms)
+{
+    delay(ms);
+}
+
+// Notification wait: a halWake() given while loop() was busy ends the next sleep at once
+bool halSleepUs(uint32_t us)
+{
+    if (us < 1000)
+    {
+        delayMicroseconds(us);
+        return false;
+    }
+    return ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(us / 1000)) != 0;
+}
+
+void HAL_ISR halWake()
+{
+    BaseType_t isWoken = pdFALSE;
+
+    if (halSleeper == NULL)
+        return;
+    vTaskNotifyGiveFromISR(halSleeper, &isWoken);
+    if (isWoken)
+        portYIELD_FROM_ISR();
+}
+
+void halAdcBegin(const uint16_t *pins, int count)
+{
+    halAdcPins = pins;
+    for (int i = 0; i < count; i++)
+        pinMode(pins[i], INPUT);
+}
+
+uint16_t halAdcRead(int ch)
+{
+    return analogRead(halAdcPins[ch]);
+}
+
+static void halTimerTick(void *arg)
+{
+    ((void (*)())arg)();
+}
+
+void halTimerStartPeriodic(uint32_t periodUs, void (*callback)())
+{
+    esp_timer_create_args_t args = {};
+
+    args.callback = halTimerTick;
+    args.arg = (void *)callback;
+    args.name = "hal";
+    esp_timer_create(&args, &halTimer);
+    esp_timer_start_periodic(halTimer, periodUs);
+}
+
+struct HalTask
+{
+    const char *name;
+    void (*fn)();
+    uint32_t periodMs;
+    TaskHandle_t handle;
+};
+
+const int halTaskMax = 4;
+static HalTask *halTasks[halTaskMax];
+static int halTaskNum = 0;
+
+static void halTaskLoop(void *arg)
+{
+    HalTask *task = (HalTask *)arg;
+    TickType_t wake = xTaskGetTickCount();
+
+    for (;;)
+    {
+        task->fn();
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(task->periodMs));
+    }
+}
+
+void halTaskStartPeriodic(const char *name, void (*fn)(), uint32_t periodMs, int core)
+{
+    HalTask *task = new HalTask{name, fn, periodMs, NULL}; // Lives as long as the task (forever)
+
+    xTaskCreatePinnedToCore(halTaskLoop, name, 4096, task, configMAX_PRIORITIES - 2, &task->handle,
+                            core);
+    if (halTaskNum < halTaskMax)
+        halTasks[halTaskNum++] = task;
+}
+
+// ESP-IDF reports the high-water mark in bytes
+uint32_t halTaskStackFree(const char *name)
+{
+    if (name == NULL)
+        return uxTaskGetStackHighWaterMark(NULL);
+    for (int i = 0; i < halTaskNum; i++)
+    {
+        if (strcmp(halTasks[i]->name, name) == 0)
+            return uxTaskGetStackHighWaterMark(halTasks[i]->handle);
+    }
+    return 0;
+}
+
+uint32_t halCycleCount()
+{
+    return ESP.getCycleCount();
+}
+
+uint32_t halCyclesPerUs()
+{
+    return ESP.getCpuFreqMHz();
+}
+
+uint32_t halSerialWritable()
+{
+    return Serial.availableForWrite();
+}
+
+void halSerialWrite(const uint8_t *data, uint32_t len)
+{
+    Serial.write(data, len);
+}
+
+// Access point of our own: the node and the device work without a router
+bool halLinkBegin(const char *ssid, const char *password, uint16_t port)
+{
+    WiFi.mode(WIFI_AP);
+    WiFi.setSleep(false); // Power save delays frames by up to a beacon interval
+    return WiFi.softAP(ssid, password) && halLinkUdp.begin(port);
+}
+
+bool halLinkSend(const uint8_t *data, uint32_t len)
+{
+    if (halLinkPeerPort == 0 || !halLinkUdp.beginPacket(halLinkPeer, halLinkPeerPort))
+        return false;
+    halLinkUdp.write(data, len);
+    return halLinkUdp.endPacket();
+}
+
+uint32_t halLinkReceive(uint8_t *buf, uint32_t size)
+{
+    int len;
+
+    while ((len = halLinkUdp.parsePacket()) > 0)
+    {
+        halLinkPeer = halLinkUdp.remoteIP();
+        halLinkPeerPort = halLinkUdp.remotePort();
+        if ((uint32_t)len <= size)
+            return halLinkUdp.read(buf, len);
+        halLinkUdp.flush(); // Too big to be ours
+    }
+    return 0;
+}
+
+// M5.begin() mounts the card
+bool halStorageBegin(const char *dir)
+{
+    if (SD.cardType() == CARD_NONE)
+        return false;
+    return SD.exists(dir) || SD.mkdir(dir);
+}
+
+uint32_t halFileSize(const char *path)
+{
+    File file = SD.open(path, FILE_READ);
+    uint32_t size;
+
+    if (!file)
+        return 0;
+    size = file.size();
+    file.close();
+    return size;
+}
+
+bool halFileRead(const char *path, uint32_t offset, void *buf, uint32_t len)
+{
+    File file = SD.open(path, FILE_READ);
+    bool isOk;
+
+    if (!file)
+        return false;
+    isOk = file.seek(offset) && file.read((uint8_t *)buf, len) == len;
+    file.close();
+    return isOk;
+}
+
+bool halFileWrite(const char *path, uint32_t offset, const void *data, uint32_t len)
+{
+    File file = SD.open(path, SD.exists(path) ? "r+" : "w");
+    bool isOk;
+
+    if (!file)
+        return false;
+    isOk = file.seek(offset) && file.write((const uint8_t *)data, len) == len;
+    file.close(); // Flushes the directory entry too, nothing is left half written in RAM
+    return isOk;
+}
+
+uint32_t halEpochSeconds()
+{
+    time_t now = time(NULL);
+
+    return now > 1600000000 ? (uint32_t)now : 0; // Before 2020: never set since boot
+}
+
+void halSetEpochSeconds(uint32_t sec)
+{
+    struct timeval tv = {(time_t)sec, 0};
+
+    settimeofday(&tv, NULL);
+}
+
+void halSpeakerBegin()
+{
+    M5.Speaker.begin();
+}
+
+void halSpeakerTone(uint16_t freqHz)
+{
+    M5.Speaker.tone(freqHz);
+}
+
+void halSpeakerMute()
+{
+    M5.Speaker.mute();
+}
+
+void halSpeakerSetVolume(uint8_t volume)
+{
+    M5.Speaker.setVolume(volume);
+}
+
+static void HAL_ISR halButtonIsr(void *arg)
+{
+    int button = (int)(intptr_t)arg;
+
+    halButtonEdge(button, digitalRead(halButtonPins[button]) == LOW);
+}
+
+// Called from setup(): the interrupts are taken on its core, halWake() wakes its task
+void halButtonsBegin(void (*onEdge)(int button, bool isDown))
+{
+    halButtonEdge = onEdge;
+    halSleeper = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < halButtonCount; i++)
+    {
+        pinMode(halButtonPins[i], INPUT);
+        attachInterruptArg(halButtonPins[i], halButtonIsr, (void *)(intptr_t)i, CHANGE);
+    }
+}
+
+bool halButtonDown(int button)
+{
+    return digitalRead(halButtonPins[button]) == LOW;
+}
+
+// The legacy block and the settings fallback region share the EEPROM emulation
+static int halEepromSize = 0;
+
+void halEepromBegin(int size)
+{
+    if (size <= halEepromSize)
+        return;
+    EEPROM.begin(size);
+    halEepromSize = size;
+}
+
+uint8_t halEepromRead(int addr)
+{
+    return EEPROM.read(addr);
+}
+
+void halEepromWrite(int addr, uint8_t value)
+{
+    EEPROM.write(addr, value);
+}
+
+void halEepromCommit()
+{
+    EEPROM.commit();
+}
+
+// Settings region: the "eeprom" data partition when the partition table has one of
+// two sectors or more. The stock tables make "eeprom" a single 4KB sector (the log
+// would have to erase its only good record before writing the next one), so the
+// usual region is 2 x 512 bytes in NVS instead: one key per 16 byte slot, written
+// as a blob. NVS appends every change to its own log pages and so spreads the
+// wear; the EEPROM emulation would rewrite a sector (or its whole blob) per commit.
+static const esp_partition_t *halFlashPartition = NULL;
+static nvs_handle_t halFlashNvs;
+static const uint32_t halFlashSlot = 16;
+static const uint32_t halFlashNvsSector = 512;
+static const uint32_t halFlashNvsSize = halFlashNvsSector * 2;
+static_assert(halFlashNvsSize / halFlashSlot <= 100, "NVS slot keys have two digits");
+
+uint32_t halFlashBegin(uint32_t &sectorSize)
+{
+    halFlashPartition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                 ESP_PARTITION_SUBTYPE_ANY, "eeprom");
+    if (halFlashPartition != NULL && halFlashPartition->size < 2 * SPI_FLASH_SEC_SIZE)
+        halFlashPartition = NULL;
+    if (halFlashPartition != NULL)
+    {
+        sectorSize = SPI_FLASH_SEC_SIZE;
+        return halFlashPartition->size / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+    }
+    if (nvs_open("settings", NVS_READWRITE, &halFlashNvs) != ESP_OK)
+        return 0;
+    sectorSize = halFlashNvsSector;
+    return halFlashNvsSize;
+}
+
+static void halFlashKey(uint32_t slot, char *key)
+{
+    key[0] = 's';
+    key[1] = '0' + slot / 10;
+    key[2] = '0' + slot % 10;
+    key[3] = '\0';
+}
+
+// Slot contents, erased (0xff) when the key isn't there
+static bool halFlashReadSlot(uint32_t slot, uint8_t *data)
+{
+    char key[4];
+    size_t len = halFlashSlot;
+    esp_err_t err;
+
+    halFlashKey(slot, key);
+    err = nvs_get_blob(halFlashNvs, key, data, &len);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+        memset(data, 0xff, halFlashSlot);
+    return err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND;
+}
+
+bool halFlashRead(uint32_t offset, void *buf, uint32_t len)
+{
+    uint8_t data[halFlashSlot];
+
+    if (halFlashPartition != NULL)
+        return esp_partition_read(halFlashPartition, offset, buf, len) == ESP_OK;
+    for (uint32_t i = 0; i < len; i++)
+    {
+        if ((i == 0 || (offset + i) % halFlashSlot == 0) && !halFlashReadSlot((offset + i) / halFlashSlot, data))
+            return false;
+        ((uint8_t *)buf)[i] = data[(offset + i) % halFlashSlot];
+    }
+    return true;
+}
+
+// NVS: one blob per slot touched, one commit
+bool halFlashWrite(uint32_t offset, const void *buf, uint32_t len)
+{
+    uint8_t data[halFlashSlot];
+    char key[4];
+
+    if (halFlashPartition != NULL)
+        return esp_partition_write(halFlashPartition, offset, buf, len) == ESP_OK;
+    for (uint32_t slot = offset / halFlashSlot; slot * halFlashSlot < offset + len; slot++)
+    {
+        if (!halFlashReadSlot(slot, data))
+            return false;
+        for (uint32_t i = 0; i < halFlashSlot; i++)
+        {
+            uint32_t at = slot * halFlashSlot + i;
+            if (at >= offset && at < offset + len)
+                data[i] &= ((const uint8_t *)buf)[at - offset];
+        }
+        halFlashKey(slot, key);
+        if (nvs_set_blob(halFlashNvs, key, data, halFlashSlot) != ESP_OK)
+            return false;
+    }
+    return nvs_commit(halFlashNvs) == ESP_OK;
+}
+
+// NVS: the keys go, committed with the record written next
+bool halFlashErase(uint32_t offset, uint32_t len)
+{
+    char key[4];
+
+    if (halFlashPartition != NULL)
+        return esp_partition_erase_range(halFlashPartition, offset, len) == ESP_OK;
+    for (uint32_t slot = offset / halFlashSlot; slot * halFlashSlot < offset + len; slot++)
+    {
+        halFlashKey(slot, key);
+        esp_err_t err = nvs_erase_key(halFlashNvs, key);
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+            return false;
+    }
+    return true;
+}
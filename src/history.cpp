@@ -0,0 +1,242 @@
+//
+//  Workout history on the microSD card
+//
+
+#include <stddef.h>
+#include <string.h>
+#include "hal.h"
+#include "history.h"
+
+static const char *const historyDir = "/history";
+static const char *const historyLogPath = "/history/log.bin";
+static const char *const historyDaysPath = "/history/days.bin";
+const int historySectorRecords = historySectorSize / sizeof(HistoryRecord);
+
+static bool isHistoryOn = false;
+
+// Sector being filled, and full sectors waiting for historyPoll()
+static HistoryRecord historyFill[historySectorRecords];
+static int historyFillCount;
+static HistoryRecord historyPending[historySectorsPending][historySectorRecords];
+static uint32_t historyPendingSector[historySectorsPending];
+static int historyPendingHead;
+static int historyPendingTail;
+static uint32_t historyNextSector; // Log sector historyFill goes to
+static uint32_t historyDropCount;  // Records lost to a full pending queue
+
+// Day index: the last entries, the file position of the newest one
+static HistoryDay historyDays[historyRecentDays];
+static int historyDayCount;
+static uint32_t historyDayIndex;   // Entries in days.bin
+static uint32_t historyDayDirty;   // First entry not written yet, historyDayIndex: none
+
+// Session in progress
+static uint32_t historySessionUs;
+static uint32_t historySessionEpoch;
+static uint32_t historySessionSector;
+static uint32_t historyLastRepUs;
+
+uint8_t historyCheck(const HistoryRecord &rec)
+{
+    const uint8_t *p = (const uint8_t *)&rec;
+    uint8_t sum = 0;
+
+    for (uint32_t i = 0; i < sizeof(rec); i++)
+    {
+        if (i != offsetof(HistoryRecord, check))
+            sum += p[i];
+    }
+    return ~sum;
+}
+
+// Civil date of a day number (days since 1970-01-01)
+void historyDate(uint16_t day, int &year, int &month, int &mday)
+{
+    int32_t z = day + 719468;
+    int32_t era = z / 146097;
+    int32_t doe = z - era * 146097;
+    int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int32_t mp = (5 * doy + 2) / 153;
+
+    mday = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = yoe + era * 400 + (month <= 2);
+}
+
+bool historyBegin()
+{
+    uint32_t logSize;
+    uint32_t first;
+
+    isHistoryOn = halStorageBegin(historyDir);
+    if (!isHistoryOn)
+        return false;
+
+    // A torn last sector is left behind, the next session starts on a fresh one
+    logSize = halFileSize(historyLogPath);
+    historyNextSector = (logSize + historySectorSize - 1) / historySectorSize;
+
+    historyDayIndex = halFileSize(historyDaysPath) / sizeof(HistoryDay);
+    first = historyDayIndex > historyRecentDays ? historyDayIndex - historyRecentDays : 0;
+    historyDayCount = historyDayIndex - first;
+    if (historyDayCount > 0 &&
+        !halFileRead(historyDaysPath, first * sizeof(HistoryDay), historyDays,
+                     historyDayCount * sizeof(HistoryDay)))
+        historyDayCount = 0;
+    historyDayDirty = historyDayIndex;
+    return true;
+}
+
+// Queue the sector being filled (padded) for writing
+static void historyQueueFill()
+{
+    int next = (historyPendingHead + 1) % historySectorsPending;
+
+    if (historyFillCount == 0)
+        return;
+    memset(&historyFill[historyFillCount], 0,
+           (historySectorRecords - historyFillCount) * sizeof(HistoryRecord));
+    if (next == historyPendingTail)
+        historyDropCount += historyFillCount; // Card gone or far behind
+    else
+    {
+        memcpy(historyPending[historyPendingHead], historyFill, sizeof(historyFill));
+        historyPendingSector[historyPendingHead] = historyNextSector;
+        historyPendingHead = next;
+    }
+    historyNextSector++;
+    historyFillCount = 0;
+}
+
+static void historyAppend(uint8_t type, uint8_t set, uint8_t side, uint32_t time,
+                          uint16_t count, uint16_t extra, uint32_t value)
+{
+    HistoryRecord &rec = historyFill[historyFillCount];
+
+    if (!isHistoryOn)
+        return;
+    rec.type = type;
+    rec.set = set;
+    rec.side = side;
+    rec.time = time;
+    rec.count = count;
+    rec.extra = extra;
+    rec.value = value;
+    rec.check = historyCheck(rec);
+    if (++historyFillCount == historySectorRecords)
+        historyQueueFill();
+}
+
+static uint32_t historySessionMs(uint32_t us)
+{
+    return (us - historySessionUs) / 1000;
+}
+
+void historyBeginSession(uint8_t mode, uint16_t sets, uint16_t reps)
+{
+    historySessionUs = halMicros();
+    historySessionEpoch = halEpochSeconds();
+    historySessionSector = historyNextSector;
+    historyLastRepUs = historySessionUs;
+    historyAppend(historySessionStart, 0, mode, historySessionEpoch, sets, reps, historySessionSector);
+}
+
+void historyAddRep(uint8_t set, uint8_t side, uint16_t rep, uint32_t onsetUs)
+{
+    uint32_t intervalMs = (onsetUs - historyLastRepUs) / 1000;
+
+    historyLastRepUs = onsetUs;
+    historyAppend(historyRep, set, side, historySessionMs(onsetUs), rep, 0,
+                  rep > 1 && intervalMs < 0xffff ? intervalMs : 0);
+}
+
+void historyEndSet(uint8_t set, uint16_t reps, uint16_t meanIntervalMs)
+{
+    uint32_t now = halMicros();
+
+    historyAppend(historySetEnd, set, 0, historySessionMs(now), reps, meanIntervalMs,
+                  historySessionMs(now));
+}
+
+// Close the log sector and fold the session into its day. Without the clock
+// there is no day: the session is in the log only.
+void historyEndSession(uint8_t sets, uint16_t totalReps, bool isAborted)
+{
+    uint32_t activeMs = historySessionMs(halMicros());
+    uint16_t day = historySessionEpoch / 86400;
+    HistoryDay *last = historyDayCount > 0 ? &historyDays[historyDayCount - 1] : NULL;
+
+    if (!isHistoryOn)
+        return;
+    historyAppend(historySessionEnd, sets, isAborted, activeMs, totalReps, 0, activeMs);
+    historyQueueFill();
+    if (day == 0)
+        return;
+
+    if (last == NULL || last->day != day)
+    {
+        if (historyDayCount == historyRecentDays)
+        {
+            memmove(historyDays, historyDays + 1, sizeof(historyDays) - sizeof(HistoryDay));
+            historyDayCount--;
+        }
+        last = &historyDays[historyDayCount++];
+        *last = HistoryDay{day, 0, 0, 0, historySessionSector};
+        historyDayIndex++;
+    }
+    last->sessions++;
+    last->reps += totalReps;
+    last->activeSec += activeMs / 1000;
+    if (historyDayDirty > historyDayIndex - 1)
+        historyDayDirty = historyDayIndex - 1;
+}
+
+// One write per call: a log sector first, then the day records, oldest first
+void historyPoll()
+{
+    uint32_t first = historyDayIndex - historyDayCount; // days.bin entry of historyDays[0]
+
+    if (!isHistoryOn)
+        return;
+    if (historyPendingTail != historyPendingHead)
+    {
+        if (halFileWrite(historyLogPath, historyPendingSector[historyPendingTail] * historySectorSize,
+                         historyPending[historyPendingTail], historySectorSize))
+            historyPendingTail = (historyPendingTail + 1) % historySectorsPending;
+        return; // Retried next time, the queue drops new sectors while full
+    }
+    if (historyDayDirty < historyDayIndex)
+    {
+        if (historyDayDirty < first)
+            historyDayDirty = first; // Out of RAM before the card took it
+        if (halFileWrite(historyDaysPath, historyDayDirty * sizeof(HistoryDay),
+                         &historyDays[historyDayDirty - first], sizeof(HistoryDay)))
+            historyDayDirty++;
+    }
+}
+
+uint32_t historyDropped()
+{
+    return historyDropCount;
+}
+
+int historyRecent(const HistoryDay *&days)
+{
+    days = historyDays;
+    return historyDayCount;
+}
+
+void historyWeek(uint16_t today, uint32_t &sessions, uint32_t &reps)
+{
+    sessions = 0;
+    reps = 0;
+    for (int i = 0; i < historyDayCount; i++)
+    {
+        if (historyDays[i].day + 7 > today && historyDays[i].day <= today)
+        {
+            sessions += historyDays[i].sessions;
+            reps += historyDays[i].reps;
+        }
+    }
+}
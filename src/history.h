@@ -0,0 +1,73 @@
+//
+//  Workout history on the microSD card
+//    /history/log.bin   every session as 16 byte records, 32 per 512 byte sector.
+//                       Only whole sectors are written, at sector boundaries; the
+//                       last sector of a session is padded with empty records.
+//    /history/days.bin  one HistoryDay per day with a workout, in day order, so a
+//                       weekly summary reads a few records instead of the log.
+//                       Sessions run before the clock was set have no day.
+//    Records are collected in RAM. historyPoll() writes at most one sector or
+//    index record per call from loop(): the SD card shares the SPI bus with the
+//    LCD, so it has to stay on the UI task. Counting (sensor task) never waits.
+//
+#pragma once
+
+#include <stdint.h>
+
+const uint32_t historySectorSize = 512;
+const int historySectorsPending = 4;     // Sectors held while the card is slow / busy
+const uint32_t historyPollInterval = 100; // historyPoll() period: 100ms
+const int historyRecentDays = 7;          // Days kept in RAM for the history screen
+
+const uint8_t historyEmpty = 0;        // Padding up to the end of a sector
+const uint8_t historySessionStart = 1;
+const uint8_t historyRep = 2;
+const uint8_t historySetEnd = 3;
+const uint8_t historySessionEnd = 4;
+
+// Fields by type, times in ms since the session start unless noted
+//                 set     side        time          count       extra          value
+//   SessionStart  -       count mode  epoch sec     sets        reps per set   session number
+//   Rep           set     pad         onset         rep in set  interval ms    -
+//   SetEnd        set     -           end           reps        mean interval  set duration ms
+//   SessionEnd    sets    aborted     end           total reps  -              active ms
+struct HistoryRecord
+{
+    uint8_t type;
+    uint8_t set;
+    uint8_t side;
+    uint8_t check; // ~(sum of the other 15 bytes)
+    uint32_t time;
+    uint16_t count;
+    uint16_t extra;
+    uint32_t value;
+};
+
+struct HistoryDay
+{
+    uint16_t day;      // Days since 1970-01-01, 0: clock was not set (older files only)
+    uint16_t sessions;
+    uint32_t reps;
+    uint32_t activeSec;
+    uint32_t firstSector; // Log sector of the day's first session
+};
+
+static_assert(sizeof(HistoryRecord) == 16 && historySectorSize % sizeof(HistoryRecord) == 0,
+              "History records must tile a sector");
+static_assert(sizeof(HistoryDay) == 16, "History index record size");
+
+bool historyBegin();
+void historyBeginSession(uint8_t mode, uint16_t sets, uint16_t reps);
+void historyAddRep(uint8_t set, uint8_t side, uint16_t rep, uint32_t onsetUs);
+void historyEndSet(uint8_t set, uint16_t reps, uint16_t meanIntervalMs);
+void historyEndSession(uint8_t sets, uint16_t totalReps, bool isAborted);
+void historyPoll();
+uint32_t historyDropped();
+
+// Last historyRecentDays days with workouts, oldest first
+int historyRecent(const HistoryDay *&days);
+// Sessions / reps in the 7 days up to today (needs the clock)
+void historyWeek(uint16_t today, uint32_t &sessions, uint32_t &reps);
+
+uint8_t historyCheck(const HistoryRecord &rec);
+void historyDate(uint16_t day, int &year, int &month, int &mday);
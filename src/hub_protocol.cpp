@@ -0,0 +1,71 @@
+//
+//  Gym hub protocol
+//
+
+#include <string.h>
+#include "telemetry.h"
+#include "hub_protocol.h"
+
+// Both ends are little endian (ESP32, x86 / ARM Linux), the record is copied as is
+static uint8_t *put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+size_t hubPack(const HubMessage &msg, uint8_t *packet)
+{
+    uint8_t *p = packet;
+    uint16_t crc;
+
+    *p++ = msg.type;
+    p = put32(p, msg.unit);
+    p = put32(p, msg.boot);
+    p = put32(p, msg.sequence);
+    if (msg.type == hubMsgRecord)
+    {
+        memcpy(p, &msg.record, sizeof(msg.record));
+        p += sizeof(msg.record);
+    }
+    crc = telemetryCrc16(packet, p - packet);
+    *p++ = crc;
+    *p++ = crc >> 8;
+    return p - packet;
+}
+
+bool hubUnpack(const uint8_t *packet, size_t len, HubMessage &msg)
+{
+    size_t body = len - 2;
+
+    if (len < hubHeaderSize + 2 || telemetryCrc16(packet, body) != (packet[body] | packet[body + 1] << 8))
+        return false;
+    msg.type = packet[0];
+    msg.unit = get32(packet + 1);
+    msg.boot = get32(packet + 5);
+    msg.sequence = get32(packet + 9);
+    if (msg.type == hubMsgRecord && body == hubHeaderSize + sizeof(msg.record))
+    {
+        memcpy(&msg.record, packet + hubHeaderSize, sizeof(msg.record));
+        return historyCheck(msg.record) == msg.record.check;
+    }
+    return (msg.type == hubMsgAck || msg.type == hubMsgAckDuplicate) && body == hubHeaderSize;
+}
+
+size_t hubFrame(const HubMessage &msg, uint8_t *frame)
+{
+    uint8_t packet[hubPacketMax];
+    size_t len = hubPack(msg, packet);
+
+    frame[0] = 0;
+    len = cobsEncode(packet, len, frame + 1) + 1;
+    frame[len++] = 0;
+    return len;
+}
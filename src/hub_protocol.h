@@ -0,0 +1,46 @@
+//
+//  Gym hub protocol
+//    Units report their sessions to the hub (host/hub) as the same HistoryRecords
+//    the SD log holds (history.h), one message per record, and the hub answers
+//    every record with an ack carrying its unit, boot and sequence: hubMsgAck when
+//    it took the record, hubMsgAckDuplicate when it had it already (a resend).
+//    The boot id is there for a unit that restarts: its sequence starts over with
+//    a new random boot id, and the hub starts the unit's sequence over with it.
+//    No firmware sends records yet; host/hubload plays the units, reboots included.
+//    TCP: frames 0x00, COBS(packet), 0x00 as the telemetry stream. UDP: one
+//    packet per datagram, no COBS.
+//
+//    Packet, little endian:
+//      u8  type (hubMsgRecord / hubMsgAck / hubMsgAckDuplicate)
+//      u32 unit id
+//      u32 boot id, random per start of the sender
+//      u32 sequence, +1 per record of the unit since it booted
+//      HistoryRecord (16 bytes)            hubMsgRecord only
+//      u16 CRC-16 of the bytes above (telemetryCrc16)
+//
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "history.h"
+
+const uint16_t hubPort = 47800; // TCP and UDP
+const uint8_t hubMsgRecord = 1;
+const uint8_t hubMsgAck = 2;
+const uint8_t hubMsgAckDuplicate = 3;
+const int hubHeaderSize = 13;
+const int hubPacketMax = hubHeaderSize + sizeof(HistoryRecord) + 2;
+const int hubFrameMax = hubPacketMax + 4; // COBS + 2 delimiters
+
+struct HubMessage
+{
+    uint8_t type;
+    uint32_t unit;
+    uint32_t boot;
+    uint32_t sequence;
+    HistoryRecord record; // hubMsgRecord
+};
+
+size_t hubPack(const HubMessage &msg, uint8_t *packet);
+bool hubUnpack(const uint8_t *packet, size_t len, HubMessage &msg);
+size_t hubFrame(const HubMessage &msg, uint8_t *frame);
@@ -6,204 +6,321 @@
 //    - M5Stack
 //    - Pressure sensor FSR406
 //      - 10kohms pull up (3.3V)
-//      - Directly connected to ESP32 ADC input
+//      - Directly connected to ESP32 ADC input, or on a WiFi sensor node (sensor_link.h)
 //
 //  TODOs
-//    - Add settings menu (store to EEPROM? microSD?)
 //    - Tweet workout result
-//    - Wireless (BT) connection with the knee sensor
 //
 
 #include "M5Stack.h"
 #include "M5GFX.h"
-#include "EEPROM.h"
-#include <Ticker.h>
 // #include "../../include/wifiinfo.h" // 自分環境の定義ファイル。無ければこの行はコメントに。
 #include "messages.h"
+#include "hal.h"
+#include "buttons.h"
+#include "sampler.h"
+#include "detector.h"
+#include "detection.h"
+#include "detection_params.h"
+#include "sensor_task.h"
+#include "sensor_link.h"
+#include "settings_store.h"
+#include "settings_schema.h"
+#include "textfmt.h"
+#include "digit_glyphs.h"
+#include "timer_sched.h"
+#include "audio_cue.h"
+#include "rep_stats.h"
+#include "rep_counter.h"
+#include "probe.h"
+#include "telemetry.h"
+#include "history.h"
+#include "compositor.h"
+#include "font_cache.h"
+#include "workout_program.h"
+#include "workout_programs.h"
 
 M5GFX disp;
-Ticker tickButtonBlink;
-Ticker tickBeep;
 
 //---- HW dependent
-const uint16_t adcPin[2] = {35, 36}; // 0(pin35):Right, 1(pin36):Left
+// Sensor pins: sensorPins in sampler.h
 //---- Display positions
 const uint16_t posBtn1X = 65;
 const uint16_t posBtn2X = 160;
 const uint16_t posBtn3X = 255;
 const uint16_t posBtnY = 216;
 const uint16_t posDispSettingY = 194;
-const uint16_t modeStartScreen = 1;
-const uint16_t modeRunningScreen = 2;
-const uint16_t modeSettingScreen = 3;
+const uint16_t posCounterW = 90; // Rep / rest counters: 3 digits of font 4 size 2 (28 each)
+const uint16_t posRepCountX = 95; // Right end 185, before the "/"
+const uint16_t posRepTargetMaxX = 276; // Frame line at 280
+//---- Screen states
+const int stateStart = 0;
+const int stateSetRep = 1;
+const int stateRest = 2;
+const int stateFinished = 3;
+const int stateSetting = 4;
+const int stateHistory = 5;
 //---- Color definitions
 const int colorStart = TFT_YELLOW;
 const int colorSetRep = disp.color565(255, 140, 0);
 const int colorRest = TFT_GREEN;
 const int colorComp = colorSetRep;
 const int colorSetting = TFT_WHITE;
+const int colorHistory = TFT_CYAN;
 const int colorBack = TFT_BLACK;
 //---- Other constants
-// const uint16_t setNum[3] = {3, 4, 5};
-// const uint16_t repNum[6] = {15, 20, 25, 30, 35, 40};
-// const uint16_t restNum[3] = {30, 45, 60};
-// const uint16_t volNum[6] = {0, 2, 4, 6, 8, 10};
-// dispVaplues[4] : Set, Rep, Rest, Vol
-const uint16_t settingItems = 4;
-const char *setingDispItemName[settingItems] = {"Sets", "Reps", "Rest", "Volume"};
-const uint16_t settingDispValueNum[settingItems] = {3, 6, 3, 6};
-const uint16_t settingDispValue[settingItems][6] = {3, 4, 5, 0, 0, 0,
-                                                    15, 20, 25, 30, 35, 40,
-                                                    30, 45, 60, 0, 0, 0,
-                                                    0, 2, 4, 6, 8, 10};
-
-const int eepromSize = 8;                 // 8 Bytes
-const uint32_t swReadInterval = 50;       // Detection switch (Sensor) read interval: 50ms
+// Setting items and values: settings_schema.h
+const int eepromSize = 8;                 // 8 Bytes, legacy settings block (read once for migration)
 const uint32_t buttonBlinkInterval = 750; // Button blink intercal: 750ms
-
-//---- Default of user changeable values
-uint16_t setMax = 0;     // 3 sets
-uint16_t repMax = 1;     // 20 reps
-uint16_t restTime = 1;   // 45 seconds
-uint16_t beepVolume = 2; // level 4
+const uint32_t tickInterval = swReadInterval; // Screen state update interval: 10ms
 
 //---- Others
 boolean isButtonPositive = true;   // Start button color mode, positive or negative
-int currentMode = modeStartScreen; // 1: Start Screen, 2: Running Screen, 3: Setting Screen
+void (*buttonBlinker)() = NULL;    // Blinker of the current screen
+int currentState = stateStart;     // Screen state running now
+int nextState = stateStart;        // Screen state requested by update handlers
 char btnText[3][10];
 
-//---- EEPROM mapping
-byte eeprom[] = {0, 0, 0, 0, 0, 0, 0, 0};
-/**************************************************
-    Type Name              Addr
-    byte checkSum;      // 0x00
-    byte setMax;        // 0x01 default = 3, 3 <= n <= 5
-    byte repMax;        // 0x02 default = 20, 15 <= n <= 40, 5 step
-    byte restTime;      // 0x03 default = 45, 30 <= n < 60, 15 step
-    byte beepVolume;    // 0x04 default = 4, 0 <= n <= 10, 1 step
-    byte rsvd0;         // 0x05
-    byte rsvd1;         // 0x06
-    byte rsvd2;         // 0x07
-**************************************************/
+//---- Workout progress
+int currentSet = 1;
+int currentRep = 0;
+int totalReps = 0;          // All sets of the session so far
+boolean isPaused = false;
+boolean isCalibrationSaved = false;
+int restStep = 0;           // Rest time left in 1/8 seconds
+int restRemainSec = 0;      // Rest seconds on the screen
+int restSec = 0;            // Rest after the set just done (program step)
+uint32_t setWorkUs = 0;     // Time in the set, pauses excluded (timed steps)
+uint32_t setLastUs = 0;
+int progressShown = 0;      // Progress bar height on the set screen
+
+//---- Setting menu
+int currentSettingMode = 0; // 0:item, 1:value
+int currentSettingItem = 0;
+int currentSettingValue = 0;
+
+//---- Compositor regions (sprite backed, pushed only when changed)
+struct ButtonCell
+{
+    const char *text; // NULL: nothing drawn on the panel yet
+    uint16_t fcolor;
+    uint16_t bcolor;
+};
+int regionButton[3];
+int regionRepCount;
+int regionRestTime;
+ButtonCell buttonCells[3];
+
+//---- Timers (timer_sched.h), all run from loop()
+int timerTick;  // Screen state update, every tickInterval
+int timerBlink; // Button blink
+int timerRest;  // Rest countdown, every 1/8 second
+int timerHistory; // Session log writes to the SD card
+
+//---- User changeable values, layout: settings_schema.h
+byte settings[settingsPayloadSize];
 
 //======================================
 
-void readEeprom(byte *rom)
+uint16_t setting(SettingId id)
 {
-    for (int i = 0; i < eepromSize; i++)
-        rom[i] = EEPROM.read(i);
+    return settingValue(settings, id);
 }
 
-void writeEeprom(byte *rom)
+// Integer to text on the stack (no Arduino String, no heap)
+TextBuf<12> numText(int32_t value)
 {
-    rom[0] = 0;
-    for (int i = 1; i < eepromSize; i++)
-        rom[0] += rom[i];
+    TextBuf<12> text;
+    text.addInt(value);
+    return text;
+}
 
-    for (int i = 0; i < eepromSize; i++)
-        EEPROM.write(i, rom[i]);
-    EEPROM.commit();
+// Heap high-water mark, printed at every screen change to show it stays flat
+void reportHeap()
+{
+    Serial.printf("heap free %u, min free %u\n", ESP.getFreeHeap(), ESP.getMinFreeHeap());
 }
 
-void setEepromDefault(byte *rom)
+// Wireless sensor node: nothing when the pads are wired
+void reportSensorLink()
 {
-    rom[1] = setMax;
-    rom[2] = repMax;
-    rom[3] = restTime;
-    rom[4] = beepVolume;
-    writeEeprom(rom);
+    SensorLinkStats stats;
+
+    if (!SENSOR_REMOTE)
+        return;
+    sensorLinkStats(stats);
+    Serial.printf("sensor link packets %u bad %u lost %u late %u, samples concealed %u node dropped %u\n",
+                  stats.packets, stats.bad, stats.lost, stats.late, stats.concealed, stats.nodeDropped);
+    Serial.printf("sensor link %s, syncs %u rtt %uus skew %dppm, node restarts %u\n",
+                  stats.synced ? "synced" : "not synced", stats.syncs, stats.rttUs, stats.skewPpm, stats.restarts);
 }
 
-boolean isEepromOk(byte *rom)
+// Timer lateness against the deadlines, printed with 's' and when a workout is finished.
+// "tick" missed: screen updates that overran tickInterval. Reset by 'r' and the finish screen.
+void reportTimers()
 {
-    byte sum = 0;
+    SchedStats stats;
 
-    if (rom[1] > 3) // Sets: 3 <= n <= 5
-        return false;
-    if (rom[2] > 6) // Reps: 15 <= n <= 45, step 5
-        return false;
-    if (rom[3] > 3) // Rest: 30 <= n <= 60, step 15
-        return false;
-    if (rom[4] > 6) // Volume: 0 <= n <= 10
-        return false;
+    for (int i = 0; i < schedCount(); i++)
+    {
+        schedGetStats(i, stats);
+        Serial.printf("timer %-5s fires %u missed %u late mean %uus max %uus\n", schedName(i),
+                      stats.fires, stats.missed, stats.meanLateUs, stats.maxLateUs);
+    }
+}
+
+void printLine(const char *line)
+{
+    Serial.println(line);
+}
+
+// Serial commands: 's' print the stats, 'r' reset them, 'b' raw sensor stream on / off,
+// 'c<epoch seconds>' set the clock (history dates), e.g. echo c$(date +%s) > /dev/ttyUSB0
+void pollSerialCommand()
+{
+    while (Serial.available() > 0)
+    {
+        switch (Serial.read())
+        {
+        case 's':
+            probeReport(printLine);
+            reportTimers();
+            reportHeap();
+            Serial.printf("stack free loop %u, sensor %u; samples lost %u, event drops %u, "
+                          "history drops %u\n", halTaskStackFree(NULL), halTaskStackFree("sensor"),
+                          sensorLost(), repEvents.dropped(), historyDropped());
+            reportSensorLink();
+            Serial.printf("font cache %u bytes, cells hit %u missed %u\n", fontCacheStats().fontBytes,
+                          fontCacheStats().hits, fontCacheStats().misses);
+            Serial.printf("compositor %u frames, %u pixels, %u bytes; last frame %u pixels, %u bytes\n",
+                          compositorStats().frames, compositorStats().pixels, compositorStats().bytes,
+                          compositorStats().lastFramePixels, compositorStats().lastFrameBytes);
+            break;
+        case 'r':
+            probeReset();
+            schedResetStats();
+            Serial.println("stats reset");
+            break;
+        case 'c':
+            halSetEpochSeconds(Serial.parseInt());
+            Serial.printf("clock set: %u\n", halEpochSeconds());
+            break;
+        case 'b':
+            if (telemetryActive())
+            {
+                telemetryStop();
+                Serial.printf("\nstream off: %u packets, %u samples dropped\n", telemetryPackets(),
+                              telemetryDropped());
+            }
+            else
+                telemetryStart(); // Binary from here on, host/teledump decodes it
+            break;
+        case '\r':
+        case '\n':
+            break;
+        default:
+            Serial.println("commands: s (stats), r (reset stats), b (raw sensor stream), c<epoch> (set clock)");
+            break;
+        }
+    }
+}
 
+// Settings written by older firmware: 8 byte EEPROM block, byte sum at 0x00
+boolean readLegacyEeprom(byte *data)
+{
+    byte rom[eepromSize];
+    byte sum = 0;
+
+    halEepromBegin(eepromSize);
+    for (int i = 0; i < eepromSize; i++)
+        rom[i] = halEepromRead(i);
     for (int i = 1; i < eepromSize; i++)
         sum += rom[i];
-
-    if (sum == rom[0])
-        return true;
-    else
+    if (sum != rom[0])
         return false;
+    setSettingsDefault(data);
+    data[settingSets] = rom[1];
+    data[settingReps] = rom[2];
+    data[settingRest] = rom[3];
+    data[settingVolume] = rom[4];
+    data[settingsCalibrationOffset] = rom[5];
+    data[settingsCalibrationOffset + 1] = rom[6];
+    return isSettingsOk(data);
 }
 
-// Check if the sensor is pressed. (Make detection in case of using switch)
-int isSwitchPressed(int swNum)
+void loadSettings()
 {
-    int adcVal;
-    int adcThreshold = 2000; // Pressure sensor threshold (0 ~ 4097)
-    adcVal = analogRead(adcPin[swNum]);
+    uint8_t version;
+    boolean isLoaded = settingsStoreBegin() && settingsStoreLoad(settings, version);
 
-    if (adcVal < adcThreshold)
-        return 1;
-    else
-        return 0;
+    if (isLoaded)
+        migrateSettings(settings, version);
+    if (!isLoaded || !isSettingsOk(settings))
+    {
+        if (!readLegacyEeprom(settings))
+            setSettingsDefault(settings);
+    }
+    settingsStoreStage(settings); // Written again only if new or migrated
+    settingsStoreCommit();
 }
 
-void checkSwichStatus(int &statR, int &statL)
+// Store the sensor baselines found by the start-up calibration (only if they moved)
+void saveCalibration()
 {
-    int swStatOrg[2];
-    int swStat[2] = {0, 0};
-    int chkTimes = 3;
+    boolean changed = false;
 
-    swStatOrg[0] = statR;
-    swStatOrg[1] = statL;
-    for (int i = 0; i < chkTimes; i++)
+    if (isCalibrationSaved || !detectorCalibrated(sensorDetection.detector))
+        return;
+    isCalibrationSaved = true;
+
+    for (int ch = 0; ch < settingsCalibrationChannels; ch++)
     {
-        for (int rl = 0; rl < 2; rl++)
+        byte baseline = detectorBaseline(sensorDetection.detector, ch) >> 4;
+        if (abs(baseline - settings[settingsCalibrationOffset + ch]) > 2)
         {
-            swStat[rl] += isSwitchPressed(rl);
-            delay(1); // wait for next ADC read
+            settings[settingsCalibrationOffset + ch] = baseline;
+            changed = true;
         }
-        delay(10); // wait to remove chattering
     }
-    if (swStat[0] == chkTimes)
-        statR = 1;
-    else if (swStat[0] == 0)
-        statR = 0;
-    else
-        statR = swStatOrg[0];
+    if (changed)
+    {
+        settingsStoreStage(settings);
+        settingsStoreCommit();
+    }
+}
 
-    if (swStat[1] == chkTimes)
-        statL = 1;
-    else if (swStat[1] == 0)
-        statL = 0;
-    else
-        statL = swStatOrg[1];
+// Clear the whole screen. Sprite regions have to be drawn again after this.
+void clearScreen(int bgColor)
+{
+    disp.fillRect(0, 0, 320, 240, bgColor);
+    compositorHideAll();
+    for (int i = 0; i < 3; i++)
+        buttonCells[i].text = NULL;
 }
 
-void muteBeep()
+// Redraw one button only if its label or colors changed
+void drawButtonCell(int btn, const char *text, uint16_t fcolor, uint16_t bcolor)
 {
-    M5.Speaker.mute();
+    ButtonCell &cell = buttonCells[btn];
+
+    if (cell.text == text && cell.fcolor == fcolor && cell.bcolor == bcolor)
+        return;
+    cell.text = text;
+    cell.fcolor = fcolor;
+    cell.bcolor = bcolor;
+
+    fontCacheDrawCell(compositorCanvas(regionButton[btn]), fontButton, text, fcolor, bcolor);
+    compositorMarkDirty(regionButton[btn]);
 }
 
 void drawButtons(const char *text1, uint16_t fcolor1, uint16_t bcolor1,
                  const char *text2, uint16_t fcolor2, uint16_t bcolor2,
                  const char *text3, uint16_t fcolor3, uint16_t bcolor3)
 {
-    disp.fillRect(0, posBtnY - 2, 320, 240, colorBack);
-    //    disp.loadFont(euro_b_20, SD);     // 動作が不安定だったので外部フォントの利用は一旦保留
-    disp.setTextFont(4);
-    disp.setTextSize(1);
-    disp.fillRect(posBtn1X - 42, posBtnY - 3, 84, 240, bcolor1);
-    disp.setTextColor(fcolor1);
-    disp.drawCenterString(text1, posBtn1X, posBtnY);
-    disp.fillRect(posBtn2X - 42, posBtnY - 3, 84, 240, bcolor2);
-    disp.setTextColor(fcolor2);
-    disp.drawCenterString(text2, posBtn2X, posBtnY);
-    disp.fillRect(posBtn3X - 42, posBtnY - 3, 84, 240, bcolor3);
-    disp.setTextColor(fcolor3);
-    disp.drawCenterString(text3, posBtn3X, posBtnY);
-    //    disp.unloadFont();
+    PROBE_SCOPE(probeButtons);
+    drawButtonCell(0, text1, fcolor1, bcolor1);
+    drawButtonCell(1, text2, fcolor2, bcolor2);
+    drawButtonCell(2, text3, fcolor3, bcolor3);
 }
 
 void startButtonBlinker()
@@ -211,13 +328,13 @@ void startButtonBlinker()
     if (isButtonPositive)
     {
         drawButtons(msgBtnSetting, TFT_WHITE, colorBack,
-                    msgBtnBlank, TFT_WHITE, colorBack,
+                    msgBtnHistory, TFT_WHITE, colorBack,
                     msgBtnStart, colorBack, colorStart);
     }
     else
     {
         drawButtons(msgBtnSetting, TFT_WHITE, colorBack,
-                    msgBtnBlank, TFT_WHITE, colorBack,
+                    msgBtnHistory, TFT_WHITE, colorBack,
                     msgBtnStart, colorStart, colorBack);
     }
     isButtonPositive = !isButtonPositive;
@@ -240,11 +357,90 @@ void okButtonBlinker()
     isButtonPositive = !isButtonPositive;
 }
 
-void showStartScreen()
+void blinkTimerFired()
+{
+    buttonBlinker();
+}
+
+// Blink with blinker from now on, first draw at the next timer run
+void startButtonBlink(void (*blinker)())
+{
+    isButtonPositive = true;
+    buttonBlinker = blinker;
+    schedStartIn(timerBlink, 0, buttonBlinkInterval * 1000);
+}
+
+void stopButtonBlink()
+{
+    schedStop(timerBlink);
+}
+
+// Abort / Pause buttons while running
+void drawRunningButtons(int fgColor)
+{
+    drawButtons(msgBtnAbort, fgColor, colorBack,
+                isPaused ? msgBtnRestart : msgBtnPause, fgColor, colorBack,
+                msgBtnBlank, fgColor, colorBack);
+}
+
+// Common button handling for the set / rest screens
+void runningButton(const ButtonEvent &event)
+{
+    int fgColor = currentState == stateRest ? colorRest : colorSetRep;
+
+    if (event.type != buttonPress)
+        return;
+    if (event.button == halButtonA) // Abort
+    {
+        historyEndSession(currentSet, totalReps, true);
+        nextState = stateStart;
+    }
+    else if (event.button == halButtonB) // Pause / Restart
+    {
+        isPaused = !isPaused;
+        if (isPaused)
+        {
+            schedPause(timerRest);
+            repStatsBreak();
+            repCounterBreak();
+        }
+        else
+            schedResume(timerRest);
+        drawRunningButtons(fgColor);
+    }
+}
+
+//---- Start screen
+
+static_assert(settingSchema[settingProgram].count == 1 + programBuiltinCount + programSdSlots,
+              "Program setting values: own, built-in programs, SD card slots");
+
+// Program of the Program setting. An SD slot without a valid file falls back to the own one.
+void selectProgram()
+{
+    uint16_t program = setting(settingProgram);
+    TextBuf<20> path;
+
+    if (program >= 1 && program <= programBuiltinCount)
+    {
+        programUse(*programBuiltins[program - 1]);
+        return;
+    }
+    if (program > programBuiltinCount)
+    {
+        path.add("/programs/").addInt(program - programBuiltinCount).add(".wkp");
+        if (programLoad(path.c_str()))
+            return;
+        Serial.printf("%s missing or invalid, using the own program\n", path.c_str());
+    }
+    programUseCustom(setting(settingSets), setting(settingReps), setting(settingRest), setting(settingMode));
+}
+
+void enterStartScreen()
 {
     int fgColor = colorStart;
     int bgColor = colorBack;
-    String dispString;
+    TextBuf<40> dispString;
 
     disp.fillRect(0, 0, 320, 190, bgColor);
     for (int i = 0; i < 4; i++)
@@ -258,40 +454,50 @@ void showStartScreen()
     disp.setTextColor(TFT_ORANGE);
     disp.setTextFont(4);
     disp.setTextSize(1);
-    dispString = "SET: " + String(settingDispValue[0][setMax]) + ", REP: " +
-                 String(settingDispValue[1][repMax]);
-    dispString += ", REST: " + String(settingDispValue[2][restTime]);
-    disp.drawString(dispString, 10, 158);
+    selectProgram();
+    if (setting(settingProgram) == 0)
+    {
+        dispString.add("SET: ").addInt(setting(settingSets)).add(", REP: ").addInt(setting(settingReps));
+        dispString.add(", REST: ").addInt(setting(settingRest));
+    }
+    else
+    {
+        dispString.add(programCurrent().name).add(": ").addInt(programCurrent().stepCount).add(" sets");
+        if (programRepTarget() > 0)
+            dispString.add(", ").addInt(programRepTarget()).add(" reps");
+    }
+    disp.drawString(dispString.c_str(), 10, 158);
+
+    startButtonBlink(startButtonBlinker);
+}
 
-    drawButtons(msgBtnSetting, TFT_WHITE, colorBack,
-                msgBtnBlank, TFT_WHITE, colorBack,
-                msgBtnStart, colorBack, colorStart);
-    tickButtonBlink.attach_ms(buttonBlinkInterval, startButtonBlinker);
+void updateStartScreen()
+{
+    repEvents.clear(); // Nothing to count here
+    saveCalibration();
+}
 
-    while (1)
+void startScreenButton(const ButtonEvent &event)
+{
+    if (event.type != buttonPress)
+        return;
+    if (event.button == halButtonC) // To go to start training
     {
-        M5.update();
-        if (M5.BtnC.wasReleased()) // To go to start training
-        {
-            currentMode = modeRunningScreen;
-            tickButtonBlink.detach(); // Disable button blink
-            break;
-        }
-        if (M5.BtnA.wasReleased()) // To go to setting memu
-        {
-            currentMode = modeSettingScreen;
-            tickButtonBlink.detach(); // Disable button blink
-            break;
-        }
-        delay(30);
+        currentSet = 1;
+        totalReps = 0;
+        programStart();
+        repStatsBeginSession();
+        historyBeginSession(programStep().mode, programCurrent().stepCount, programStep().reps);
+        nextState = stateSetRep;
     }
+    else if (event.button == halButtonA) // To go to setting memu
+        nextState = stateSetting;
+    else if (event.button == halButtonB) // To see the past workouts
+        nextState = stateHistory;
 }
 
 void drawFrame(int frameColor, int bgColor)
 {
-    int yposSet = 25;
-    int yposRep = 90;
-
     disp.fillRect(0, 0, 320, 190, bgColor);
     for (int i = 0; i < 4; i++)
     {
@@ -300,152 +506,260 @@ void drawFrame(int frameColor, int bgColor)
     }
 }
 
-void drawFrameRunning(int currentSet, int frameColor, int bgColor)
+// Rep timing summary in 4 lines from y (font 2)
+void drawRepStats(const RepStats &stats, int x, int y, int fgColor)
 {
-    int yposSet = 25;
-    int yposRep = 90;
+    TextBuf<40> line;
+    int32_t drift = repStatsDriftMs(stats);
 
-    disp.fillRect(0, 0, 320, 190, bgColor);
-    for (int i = 0; i < 4; i++)
-    {
-        disp.drawRect(0 + i, 0 + i, 320 - i * 2, 190 - i * 2, frameColor);
-        disp.drawLine(280 + i, 0 + i, 280 + i, 190 - i * 2, frameColor);
-    }
-    disp.setTextColor(frameColor);
-    disp.setTextSize(2);
+    disp.setTextColor(fgColor, colorBack);
+    disp.setTextSize(1);
     disp.setTextFont(2);
-    disp.drawString("SET:", 10, yposSet);
-    disp.drawRightString(String(currentSet), 95, yposSet); // Current Set count
-    disp.drawString("/", 100, yposSet);
-    disp.drawString(String(settingDispValue[0][setMax]), 120, yposSet); // Total Set number
-    disp.setTextFont(4);
-    disp.drawString("REP:", 10, yposRep);
-    disp.drawRightString("0", 185, yposRep); // Initial rep count = 0
-    disp.drawString("/", 190, yposRep);
-    disp.drawString(String(settingDispValue[1][repMax]), 210, yposRep); // Total rep number
+    line.add("Rep interval ").addInt(statMeanMs(stats.intervalMs)).add("ms  sd ");
+    line.addInt(statStdDevMs(stats.intervalMs));
+    disp.drawString(line.c_str(), x, y);
+    line.clear();
+    line.add("p50 ").addInt(statPercentileMs(stats.intervalMs, 50));
+    line.add("  p90 ").addInt(statPercentileMs(stats.intervalMs, 90));
+    line.add("  drift ").add(drift >= 0 ? "+" : "").addInt(drift).add("/rep");
+    disp.drawString(line.c_str(), x, y + 18);
+    line.clear();
+    line.add("Press ").addInt(statMeanMs(stats.pressMs)).add("ms  min ");
+    line.addInt(stats.pressMs.minMs).add("  max ").addInt(stats.pressMs.maxMs);
+    disp.drawString(line.c_str(), x, y + 36);
+    line.clear();
+    line.add("R/L ").addInt(stats.sidePresses[0]).addChar('/').addInt(stats.sidePresses[1]);
+    drift = repStatsPressAsymMs(stats);
+    line.add("  L-R press ").add(drift >= 0 ? "+" : "").addInt(drift);
+    drift = repStatsStepAsymMs(stats);
+    line.add(" step ").add(drift >= 0 ? "+" : "").addInt(drift);
+    disp.drawString(line.c_str(), x, y + 54);
+}
+
+//---- Rest screen
+
+void drawRestTime(int fgColor)
+{
+    LGFX_Sprite &canvas = compositorCanvas(regionRestTime);
+
+    canvas.fillScreen(colorBack);
+    drawDigits(canvas, restRemainSec, posCounterW, 0, fgColor, colorBack);
+    compositorMarkDirty(regionRestTime);
 }
 
-void showRestScreen()
+void enterRestScreen()
 {
     int fgColor = colorRest;
     int bgColor = colorBack;
-    int yposRest = 75;
-    int progressY;
+    int yposRest = 20;
 
-    disp.fillRect(0, 0, 320, 240, bgColor);
+    clearScreen(bgColor);
     drawFrame(fgColor, bgColor);
     disp.fillRect(284, 4, 32, 183, fgColor); // Update progress bar
     disp.setTextColor(fgColor);
     disp.setTextSize(2);
     disp.setTextFont(4);
     disp.drawString("REST:", 10, yposRest);
-    disp.drawRightString(String(settingDispValue[2][restTime]), 220, yposRest); // Current rep count
+    restRemainSec = restSec;
+    restStep = restRemainSec * 8;
+    drawRestTime(fgColor);
+    drawRepStats(repStatsSet(), 14, 100, fgColor); // The set just done
+
+    isPaused = false;
+    drawRunningButtons(fgColor);
 
     // Beep to notify start of rest time
-    for (int i = 0; i < 1; i++)
+    audioCuePlay(cueRestStart);
+    schedStartIn(timerRest, 125000, 125000);
+}
+
+// Every 1/8 second on the timer grid, so drawing time doesn't stretch the rest
+void restTimerFired()
+{
+    int fgColor = colorRest;
+    int bgColor = colorBack;
+    int restTotalStep = restSec * 8;
+    int progressY;
+
+    restStep--;
+    if (restStep <= 0)
     {
-        delay(80);
-        M5.Speaker.beep();
-        delay(50);
-        M5.Speaker.mute();
+        schedStop(timerRest);
+        currentSet++;
+        nextState = stateSetRep;
+        return;
     }
-
-    for (int i = settingDispValue[2][restTime] * 8; i > 0; i--)
+    if (restStep % 8 == 0)
     {
-        if (i % 8 == 0)
-        {
-            disp.fillRect(160, yposRest, 60, 50, colorBack);
-            disp.drawRightString(String(i / 8), 220, yposRest);
-        }
-        progressY = 182 * (settingDispValue[2][restTime] * 8 - i) / settingDispValue[2][restTime] / 8;
-        disp.fillRect(284, 4, 32, progressY, bgColor); // Update progress bar
-        delay(125);
+        restRemainSec = restStep / 8;
+        drawRestTime(fgColor);
     }
+    progressY = 182 * (restTotalStep - restStep) / restTotalStep;
+    disp.fillRect(284, 4, 32, progressY, bgColor); // Update progress bar
+}
+
+void exitRestScreen()
+{
+    schedStop(timerRest);
+}
+
+//---- Set / Rep screen
+
+void drawRepCount(int fgColor)
+{
+    LGFX_Sprite &canvas = compositorCanvas(regionRepCount);
+
+    canvas.fillScreen(colorBack);
+    drawDigits(canvas, currentRep, posCounterW, 0, fgColor, colorBack);
+    compositorMarkDirty(regionRepCount);
 }
 
-void showSetRepScreen(int currentSet)
+// Also called again from updateSetRepScreen() for a step without rest
+void enterSetRepScreen()
 {
+    const ProgramImage &program = programCurrent();
+    const ProgramStep &step = programStep();
     int fgColor = colorSetRep;
     int bgColor = colorBack;
     int yposSet = 25;
     int yposRep = 90;
-    int currentRep = 0;
-    int swStatus[2] = {0, 0};
-    int swStatusPrev[2] = {0, 0};
-    boolean swPressed[2] = {false, false};
-    int lastStepSide = 0; // Last leg side, 1:Right, 2:Left
-    int thisStepSide = 0;
-    int progressY = 0;
+    TextBuf<12> target;
 
     // Draw initial screen
-    disp.fillRect(0, 0, 320, 240, bgColor);
+    clearScreen(bgColor);
     drawFrame(fgColor, bgColor);
 
     disp.setTextColor(fgColor);
     disp.setTextSize(2);
     disp.setTextFont(2);
     disp.drawString("SET:", 10, yposSet);
-    disp.drawRightString(String(currentSet), 95, yposSet); // Current Set count
+    disp.drawRightString(numText(currentSet).c_str(), 95, yposSet); // Current Set count
     disp.drawString("/", 100, yposSet);
-    disp.drawString(String(settingDispValue[0][setMax]), 120, yposSet); // Total Set number
+    disp.drawString(numText(program.stepCount).c_str(), 120, yposSet); // Total Set number
+    if (program.exerciseCount > 0)
+    {
+        disp.setTextSize(1);
+        disp.drawString(program.exercises[step.exercise], 170, yposSet + 8);
+        disp.setTextSize(2);
+    }
+    disp.drawString("REP:", 10, yposRep + 10); // Font 2 as SET, leaves the count 3 digits
     disp.setTextFont(4);
-    disp.drawString("REP:", 10, yposRep);
-    disp.drawRightString("0", 185, yposRep); // Initial rep count = 0
     disp.drawString("/", 190, yposRep);
-    disp.drawString(String(settingDispValue[1][repMax]), 210, yposRep); // Total rep number
+    if (step.reps != 0)
+        target.addInt(step.reps); // Total rep number
+    else
+        target.addInt(step.workSec).addChar('s'); // Timed: reps are only counted
+    if (210 + disp.textWidth(target.c_str()) > posRepTargetMaxX)
+    {
+        disp.setTextSize(1); // 3 digits: half size, bottom aligned with the count
+        disp.drawString(target.c_str(), 210, yposRep + 26);
+        disp.setTextSize(2);
+    }
+    else
+        disp.drawString(target.c_str(), 210, yposRep);
+
+    currentRep = 0;
+    setWorkUs = 0;
+    setLastUs = halMicros();
+    progressShown = 0;
+    repStatsBeginSet();
+    repCounterBegin((CountMode)step.mode);
+    drawRepCount(fgColor); // Initial rep count = 0
+    isPaused = false;
+    drawRunningButtons(fgColor);
+
+    // Beep to notify start
+    audioCuePlay((AudioCue)step.cue);
+    repEvents.clear(); // Ignore presses during the rest time
+}
 
-    // Beep to notify finish
-    for (int i = 0; i < 2; i++)
+// Set done: rest, the next step at once (superset), or finished
+void endSet()
+{
+    historyEndSet(currentSet, currentRep, statMeanMs(repStatsSet().intervalMs));
+    restSec = programStep().restSec;
+    if (!programNext())
+        nextState = stateFinished;
+    else if (restSec == 0)
     {
-        M5.Speaker.beep();
-        delay(50);
-        M5.Speaker.mute();
-        delay(80);
+        currentSet++;
+        enterSetRepScreen(); // Same state, so not through the state machine
     }
+    else
+        nextState = stateRest;
+}
+
+void updateSetRepScreen()
+{
+    const ProgramStep &step = programStep();
+    int fgColor = colorSetRep;
+    int counted = 0;
+    int progressY = 0;
+    uint32_t now = halMicros();
+    RepEvent ev;
 
-    while (1)
+    if (!isPaused)
+        setWorkUs += now - setLastUs;
+    setLastUs = now;
+
+    // Rep events from the sensor task, each side on its own.
+    // Keep draining while paused, but don't count.
+    while ((step.reps == 0 || currentRep + counted < step.reps) && repEvents.pop(ev))
     {
-        checkSwichStatus(swStatus[0], swStatus[1]);
-        thisStepSide = 0;
-        for (int i = 0; i < 2; i++)
+        if (isPaused)
+            continue;
+        if (ev.type == repEventPress)
+            repStatsPress(ev.side, ev.timeUs);
+        else
+            repStatsRelease(ev.side, ev.timeUs);
+        if (repCounterEvent(ev))
         {
-            if (swStatus[i] == 1 && swStatusPrev[i] == 0)
-            {
-                swPressed[i] = true;
-                thisStepSide |= 0x01 << 1;
-            }
-            swStatusPrev[i] = swStatus[i];
+            repStatsRep(ev.timeUs);
+            PROBE_RECORD_US(probeRepLatency, halMicros() - ev.timeUs);
+            counted++;
+            historyAddRep(currentSet, ev.side, currentRep + counted, ev.timeUs);
         }
-        if (thisStepSide != 0)
+    }
+    if (counted > 0)
+    {
+        // Short click
+        audioCuePlay(cueRep);
+        // Count up
+        currentRep += counted;
+        totalReps += counted;
+        if (currentRep == step.reps)
         {
-            // Short beep
-            M5.Speaker.beep();
-            tickBeep.once_ms(10, muteBeep);
-            // Count up
-            currentRep++;
-            if (currentRep == settingDispValue[1][repMax])
-                break;
-            disp.setTextSize(2);
-            disp.setTextFont(4);
-            disp.fillRect(130, yposRep, 55, 50, colorBack);
-            disp.drawRightString(String(currentRep), 185, yposRep); // Update rep number
-            progressY = 182 * currentRep / settingDispValue[1][repMax];
-            disp.fillRect(284, 186 - progressY, 32, progressY, fgColor); // Update progress bar
-
-            for (int i = 0; i < 2; i++)
-                swPressed[i] = 0;
-            lastStepSide = thisStepSide;
+            endSet();
+            return;
         }
-        delay(swReadInterval);
+        PROBE_SCOPE(probeRepDraw);
+        drawRepCount(fgColor); // Update rep number
+    }
+    if (step.reps == 0 && setWorkUs >= step.workSec * 1000000UL)
+    {
+        endSet();
+        return;
+    }
+
+    if (step.reps != 0)
+        progressY = 182 * currentRep / step.reps;
+    else
+        progressY = 182 * (setWorkUs / 1000) / (step.workSec * 1000UL);
+    if (progressY != progressShown)
+    {
+        disp.fillRect(284, 186 - progressY, 32, progressY, fgColor); // Update progress bar
+        progressShown = progressY;
     }
 }
 
-void showFinishedScreen()
+//---- Finished screen
+
+void enterFinishedScreen()
 {
     int fgColor = colorSetRep;
     int bgColor = colorBack;
 
-    disp.fillRect(0, 0, 320, 240, bgColor);
+    clearScreen(bgColor);
     for (int i = 0; i < 4; i++)
     {
         disp.drawRect(0 + i, 0 + i, 320 - i * 2, 190 - i * 2, fgColor);
@@ -453,43 +767,98 @@ void showFinishedScreen()
     disp.setTextColor(fgColor);
     disp.setTextFont(4);
     disp.setTextSize(2);
-    disp.drawCentreString("Finished!", 155, 40);
-    disp.drawCentreString("Good Job!", 155, 100);
+    disp.drawCentreString("Finished!", 155, 12);
+    disp.setTextSize(1);
+    disp.drawCentreString("Good Job!", 155, 72);
+    drawRepStats(repStatsSession(), 30, 106, fgColor); // Whole session
+    historyEndSession(currentSet, totalReps, false);
 
     // Beep for finish
-    for (int i = 0; i < 5; i++)
-    {
-        M5.Speaker.beep();
-        delay(20);
-        M5.Speaker.mute();
-        delay(80);
-    }
+    audioCuePlay(cueFinish);
 
-    tickButtonBlink.attach_ms(buttonBlinkInterval, okButtonBlinker);
-    while (1)
+    startButtonBlink(okButtonBlinker);
+    reportTimers();
+    schedResetStats(); // Next workout starts from zero
+}
+
+void finishedScreenButton(const ButtonEvent &event)
+{
+    if (event.type == buttonPress && event.button == halButtonC)
+        nextState = stateStart;
+}
+
+//---- History screen
+
+// "2026-10-16", or "(no date)" for sessions done before the clock was set
+void addDate(TextBuf<48> &text, uint16_t day)
+{
+    int year, month, mday;
+
+    if (day == 0)
     {
-        M5.update();
-        if (M5.BtnC.wasReleased())
-        {
-            tickButtonBlink.detach();
-            break;
-        }
-        delay(30);
+        text.add("(no date) ");
+        return;
     }
+    historyDate(day, year, month, mday);
+    text.addInt(year).addChar('-').add(month < 10 ? "0" : "").addInt(month);
+    text.addChar('-').add(mday < 10 ? "0" : "").addInt(mday);
 }
 
-void showRunningScreen()
+void enterHistoryScreen()
 {
-    for (int sets = 1; sets <= settingDispValue[0][setMax]; sets++)
+    int fgColor = colorHistory;
+    int bgColor = colorBack;
+    const HistoryDay *days;
+    int dayCount = historyRecent(days);
+    uint16_t today = halEpochSeconds() / 86400;
+    uint32_t weekSessions, weekReps;
+    TextBuf<48> line;
+    int y = 56;
+
+    clearScreen(bgColor);
+    disp.setTextColor(fgColor);
+    disp.setTextFont(4);
+    disp.setTextSize(1);
+    disp.drawString("History", 10, 8);
+    disp.setTextFont(2);
+    if (today != 0)
     {
-        showSetRepScreen(sets);
-        if (sets < settingDispValue[0][setMax])
-            showRestScreen();
+        historyWeek(today, weekSessions, weekReps);
+        line.add("Last 7 days: ").addInt(weekSessions).add(" sessions, ").addInt(weekReps).add(" reps");
     }
-    showFinishedScreen();
-    currentMode = 1;
+    else
+        line.add("Clock not set (send c<epoch> on Serial)");
+    disp.drawString(line.c_str(), 10, 34);
+
+    if (dayCount == 0)
+        disp.drawString("No workouts recorded", 10, y);
+    for (int i = dayCount - 1; i >= 0 && i >= dayCount - 6; i--, y += 22) // Newest first
+    {
+        line.clear();
+        addDate(line, days[i].day);
+        line.add("  ").addInt(days[i].sessions).add(" sessions  ").addInt(days[i].reps);
+        line.add(" reps  ").addInt(days[i].activeSec / 60).add(" min");
+        disp.drawString(line.c_str(), 10, y);
+    }
+
+    drawButtons(msgBtnReturn, fgColor, bgColor,
+                msgBtnBlank, fgColor, bgColor,
+                msgBtnBlank, fgColor, bgColor);
+}
+
+void updateHistoryScreen()
+{
+    repEvents.clear(); // Nothing to count here
 }
 
+void historyScreenButton(const ButtonEvent &event)
+{
+    if (event.type == buttonPress && event.button == halButtonA)
+        nextState = stateStart;
+}
+
+//---- Setting screen
+
 void drawSettingItems(int itemNum)
 {
     int fgColor1 = TFT_WHITE;
@@ -509,13 +878,13 @@ void drawSettingItems(int itemNum)
     for (int i = 0; i < settingItems; i++)
     {
         disp.fillRect(posItemsX, posItemsY + posItemsH * i, posItemsW, posItemsH, bgColor1);
-        disp.drawString(setingDispItemName[i], posItemsX + 12, posItemsY + 4 + posItemsH * i);
+        disp.drawString(settingSchema[i].name, posItemsX + 12, posItemsY + 4 + posItemsH * i);
     }
     disp.drawRect(posItemsX, posItemsY + posItemsH * itemNum, posItemsW, posItemsH, fgColor1);
     disp.drawRect(posItemsX + 1, posItemsY + 1 + posItemsH * itemNum, posItemsW - 2, posItemsH - 2,
                   fgColor1);
     disp.setTextColor(fgColor1);
-    disp.drawString(setingDispItemName[itemNum], posItemsX + 12, posItemsY + 4 + posItemsH * itemNum);
+    disp.drawString(settingSchema[itemNum].name, posItemsX + 12, posItemsY + 4 + posItemsH * itemNum);
 }
 
 void drawSettingValues(int itemNum, int valueNum)
@@ -530,19 +899,24 @@ void drawSettingValues(int itemNum, int valueNum)
     int posValueY = 0;
     int posValueH = 34;
     int posValueW = 100;
-    String valueDisp;
+    TextBuf<programNameMax + 1> valueDisp;
 
-    disp.setTextFont(4);
     disp.setTextSize(1);
 
-    for (int i = 0; i < settingDispValueNum[itemNum]; i++)
+    for (int i = 0; i < settingSchema[itemNum].count; i++)
     {
-        valueDisp = String(settingDispValue[itemNum][i]);
-        if (i == eeprom[itemNum + 1])
+        valueDisp.clear();
+        if (itemNum == settingProgram && i >= 1 && i <= programBuiltinCount)
+            valueDisp.add(programBuiltins[i - 1]->name); // Order set by make programs
+        else if (settingSchema[itemNum].labels != NULL)
+            valueDisp.add(settingSchema[itemNum].labels[i]);
+        else
+            valueDisp.addInt(settingSchema[itemNum].values[i]);
+        if (i == settings[itemNum])
         {
             fgColor = fgColor2;
             bgColor = bgColor2;
-            valueDisp += "*";
+            valueDisp.addChar('*');
         }
         else
         {
@@ -551,132 +925,199 @@ void drawSettingValues(int itemNum, int valueNum)
         }
         disp.fillRect(posValueX, posValueY + posValueH * i, posValueW, posValueH, bgColor1);
         disp.setTextColor(fgColor);
-        disp.drawCenterString(valueDisp, posValueX + posValueW / 2,
-                              posValueY + 6 + posValueH * i);
+        disp.setTextFont(4);
+        if (disp.textWidth(valueDisp.c_str()) > posValueW - 8)
+            disp.setTextFont(2); // Long program name
+        disp.drawCenterString(valueDisp.c_str(), posValueX + posValueW / 2,
+                              posValueY + (disp.fontHeight() > 20 ? 6 : 10) + posValueH * i);
     }
     disp.drawRect(posValueX, posValueY + posValueH * valueNum, posValueW, posValueH, fgColor1);
     disp.drawRect(posValueX + 1, posValueY + 1 + posValueH * valueNum, posValueW - 2, posValueH - 2,
                   fgColor1);
 }
 
-void showSettingScreen()
+void enterSettingScreen()
 {
     int fgColor = colorSetting;
     int bgColor = colorBack;
-    int currentSettingMode = 0; // 0:item, 1:value
-    int currentSettingItem = 0;
-    int currentSettingValue = 0;
 
-    disp.fillRect(0, 0, 320, 240, bgColor);
+    currentSettingMode = 0;
+    currentSettingItem = 0;
+    currentSettingValue = 0;
+
+    clearScreen(bgColor);
 
     drawButtons(msgBtnReturn, fgColor, bgColor,
                 msgBtnNext, fgColor, bgColor,
                 msgBtnSelect, fgColor, bgColor);
 
     drawSettingItems(currentSettingItem);
+}
+
+void exitSettingScreen()
+{
+    settingsStoreCommit();
+}
 
-    while (1)
+// B held: keeps stepping (long press repeats)
+void settingScreenButton(const ButtonEvent &event)
+{
+    if (event.type == buttonRelease)
+        return;
+    if (event.type == buttonLongPress && event.button != halButtonB)
+        return;
+    if (event.button == halButtonA) // Retrn
     {
-        M5.update();
-        if (M5.BtnA.wasReleased()) // Retrn
+        if (currentSettingMode == 0) // If item selection, exit setting mode
         {
-            if (currentSettingMode == 0) // If item selection, exit setting mode
-            {
-                currentMode = modeStartScreen;
-                break;
-            }
-            else if (currentSettingMode == 1)
-            {
-                currentSettingMode = 0; // If value selection, return to item selection
-                drawSettingItems(currentSettingItem);
-            }
+            nextState = stateStart;
+            return;
         }
-        if (M5.BtnB.wasReleased()) // Move to next item
+        else if (currentSettingMode == 1)
         {
-            if (currentSettingMode == 0)
-            {
-                currentSettingItem++;
-                if (currentSettingItem > settingItems - 1)
-                    currentSettingItem = 0;
-                drawSettingItems(currentSettingItem);
-            }
-            else if (currentSettingMode == 1)
-            {
-                currentSettingValue++;
-                if (currentSettingValue > settingDispValueNum[currentSettingItem] - 1)
-                    currentSettingValue = 0;
-                drawSettingValues(currentSettingItem, currentSettingValue);
-            }
+            currentSettingMode = 0; // If value selection, return to item selection
+            drawSettingItems(currentSettingItem);
         }
-        if (M5.BtnC.wasReleased()) // Go to value selection
+    }
+    if (event.button == halButtonB) // Move to next item
+    {
+        if (currentSettingMode == 0)
         {
-            if (currentSettingMode == 0) // If item selection, exit setting mode
-            {
-                currentSettingMode = 1;
-                currentSettingValue = eeprom[currentSettingItem + 1];
-                drawSettingValues(currentSettingItem, currentSettingValue);
-            }
-            else if (currentSettingMode == 1)
-            {
-                eeprom[currentSettingItem + 1] = byte(currentSettingValue);
-                writeEeprom(eeprom);
-                setMax = eeprom[1];
-                repMax = eeprom[2];
-                restTime = eeprom[3];
-                beepVolume = eeprom[4];
-                M5.Speaker.setVolume(beepVolume);
-                drawSettingValues(currentSettingItem, currentSettingValue);
-            }
+            currentSettingItem++;
+            if (currentSettingItem > settingItems - 1)
+                currentSettingItem = 0;
+            drawSettingItems(currentSettingItem);
+        }
+        else if (currentSettingMode == 1)
+        {
+            currentSettingValue++;
+            if (currentSettingValue > settingSchema[currentSettingItem].count - 1)
+                currentSettingValue = 0;
+            drawSettingValues(currentSettingItem, currentSettingValue);
+        }
+    }
+    if (event.button == halButtonC) // Go to value selection
+    {
+        if (currentSettingMode == 0) // If item selection, exit setting mode
+        {
+            currentSettingMode = 1;
+            currentSettingValue = settings[currentSettingItem];
+            drawSettingValues(currentSettingItem, currentSettingValue);
+        }
+        else if (currentSettingMode == 1)
+        {
+            settings[currentSettingItem] = byte(currentSettingValue);
+            settingsStoreStage(settings); // Written to flash when leaving the menu
+            audioCueSetVolume(setting(settingVolume));
+            drawSettingValues(currentSettingItem, currentSettingValue);
         }
-        delay(30);
     }
 }
 
-void setup(void)
-{
-    Serial.begin(115200);
-    M5.begin();
-    EEPROM.begin(eepromSize);
-    M5.Speaker.begin();
-    M5.Speaker.setVolume(beepVolume);
-    disp.begin();
-
-    readEeprom(eeprom);
-    if (!isEepromOk(eeprom))
-        setEepromDefault(eeprom);
+//---- Scheduler
 
-    setMax = eeprom[1];
-    repMax = eeprom[2];
-    restTime = eeprom[3];
-    beepVolume = eeprom[4];
+struct ScreenState
+{
+    void (*enter)();
+    void (*update)(); // Called every tickInterval, must not block. NULL: nothing to do
+    void (*button)(const ButtonEvent &event);
+    void (*exit)();
+};
+
+const ScreenState screenStates[] = {
+    {enterStartScreen, updateStartScreen, startScreenButton, stopButtonBlink}, // stateStart
+    {enterSetRepScreen, updateSetRepScreen, runningButton, NULL},              // stateSetRep
+    {enterRestScreen, NULL, runningButton, exitRestScreen},                    // stateRest
+    {enterFinishedScreen, NULL, finishedScreenButton, stopButtonBlink},        // stateFinished
+    {enterSettingScreen, NULL, settingScreenButton, exitSettingScreen},        // stateSetting
+    {enterHistoryScreen, updateHistoryScreen, historyScreenButton, NULL},      // stateHistory
+};
+
+void switchScreen()
+{
+    if (nextState == currentState)
+        return;
+    if (screenStates[currentState].exit != NULL)
+        screenStates[currentState].exit();
+    currentState = nextState;
+    screenStates[currentState].enter();
+    reportHeap();
+}
 
-    //    showStartScreen();
-    Serial.println("Start...");
+// timerTick: one step of the screen state machine, also run as soon as a button
+// interrupt wakes loop(). Each button event goes to the screen shown at the time.
+void runStateMachine()
+{
+    ButtonEvent event;
 
-    for (int i = 0; i < 2; i++)
+    while (buttonsNext(event))
     {
-        pinMode(adcPin[i], INPUT);
+        screenStates[currentState].button(event);
+        switchScreen();
     }
+    if (screenStates[currentState].update != NULL)
+        screenStates[currentState].update();
+    switchScreen();
+    {
+        PROBE_SCOPE(probeDraw);
+        compositorFlush();
+    }
+    pollSerialCommand();
 }
 
-void loop()
+void setup(void)
 {
-    switch (currentMode)
-    {
-    case modeStartScreen: // Start Screen
-        showStartScreen();
-        break;
-
-    case modeRunningScreen: // Running Screen
-        showRunningScreen();
-        break;
+    Serial.setTxBufferSize(telemetryTxBuffer); // Before begin()
+    Serial.begin(115200);
+    halBegin();
+    disp.begin();
+    compositorBegin(&disp);
+    regionButton[0] = compositorAddRegion(posBtn1X - 42, posBtnY - 3, 84, 27);
+    regionButton[1] = compositorAddRegion(posBtn2X - 42, posBtnY - 3, 84, 27);
+    regionButton[2] = compositorAddRegion(posBtn3X - 42, posBtnY - 3, 84, 27);
+    regionRepCount = compositorAddRegion(posRepCountX, 90, posCounterW, 50);
+    regionRestTime = compositorAddRegion(160, 20, posCounterW, 50);
+    clearScreen(colorBack);
+    digitGlyphsBegin(&disp, 4, 2); // Rep / rest counters: font 4, size 2
+    fontCacheBegin();              // Button font from the SD card, built-in font 4 without it
+
+    audioCueBegin();
+    loadSettings();
+    historyBegin(); // No card: nothing is logged
+    audioCueSetVolume(setting(settingVolume));
+
+    Serial.println("Start... (send s on Serial for timing stats)");
+
+    uint16_t storedBaseline[sampleChannels] = {0}; // Pads without a stored level: 0
+    for (int ch = 0; ch < settingsCalibrationChannels; ch++)
+        storedBaseline[ch] = settings[settingsCalibrationOffset + ch] << 4;
+    // Calibrates with the first samples, keep off the sensors
+    detectionBegin(sensorDetection, storedBaseline, detectionTuned);
+    // Sampling and detection on core 0, UI stays on core 1
+    sensorTaskBegin(SENSOR_REMOTE ? sensorRemote : sensorLocal, sensorPins);
+
+    buttonsBegin();
+    timerTick = schedCreate("tick", runStateMachine);
+    timerBlink = schedCreate("blink", blinkTimerFired);
+    timerRest = schedCreate("rest", restTimerFired);
+    timerHistory = schedCreate("history", historyPoll);
+
+    currentState = nextState = stateStart;
+    screenStates[currentState].enter();
+    compositorFlush();
+    reportHeap();
+    schedStartIn(timerTick, 0, tickInterval * 1000);
+    schedStartIn(timerHistory, historyPollInterval * 1000, historyPollInterval * 1000);
+}
 
-    case modeSettingScreen: // Setting Screen
-        showSettingScreen();
-        break;
+// Sleep until the next timer deadline, then run the due timers.
+// A button wakes it early and moves the tick to now.
+void loop()
+{
+    int32_t waitUs = schedUntilNextUs();
 
-    default:
-        currentMode = modeStartScreen;
-        break;
-    }
+    if (waitUs > 0 && halSleepUs(waitUs))
+        schedStartIn(timerTick, 0, tickInterval * 1000);
+    PROBE_SCOPE(probeLoop);
+    schedRun();
 }
@@ -16,5 +16,6 @@ const char* msgBtnOk        = "OK";
 const char* msgBtnReturn    = "Return";
 const char* msgBtnNext      = "Next";
 const char* msgBtnSelect    = "Select";
+const char* msgBtnHistory   = "History";
 
 const char* msgReady        = "Ready to Go";
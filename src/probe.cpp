@@ -0,0 +1,75 @@
+//
+//  Timing probes
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "probe.h"
+
+static ProbeHist probeHists[probeItems];
+
+static const char *const probeNames[probeItems] = {
+    "loop", "draw", "buttons", "repdraw", "detect", "replat",
+};
+
+void probeRecord(ProbeId id, uint32_t cycles)
+{
+    ProbeHist &h = probeHists[id];
+
+    h.count++;
+    h.sumCycles += cycles;
+    if (cycles > h.maxCycles)
+        h.maxCycles = cycles;
+    h.buckets[31 - __builtin_clz(cycles | 1)]++;
+}
+
+void probeReset()
+{
+    memset(probeHists, 0, sizeof(probeHists));
+}
+
+const ProbeHist &probeHist(ProbeId id)
+{
+    return probeHists[id];
+}
+
+// Upper edge of the bucket holding the percentile, capped at the max seen
+uint32_t probePercentileCycles(const ProbeHist &hist, int percent)
+{
+    uint32_t rank = (uint32_t)((uint64_t)hist.count * percent / 100);
+    uint32_t seen = 0;
+
+    for (int i = 0; i < probeBuckets; i++)
+    {
+        seen += hist.buckets[i];
+        if (seen > rank)
+        {
+            uint32_t edge = i == 31 ? 0xffffffff : (2UL << i) - 1;
+            return edge < hist.maxCycles ? edge : hist.maxCycles;
+        }
+    }
+    return hist.maxCycles;
+}
+
+// One line per probe, times in us
+void probeReport(void (*printLine)(const char *line))
+{
+    char line[96];
+    float perUs = halCyclesPerUs();
+
+    if (!ENABLE_PROBES)
+    {
+        printLine("probes compiled out (ENABLE_PROBES=0)");
+        return;
+    }
+    printLine("probe        count     mean      p50      p99      max  (us)");
+    for (int i = 0; i < probeItems; i++)
+    {
+        const ProbeHist &h = probeHists[i];
+        snprintf(line, sizeof(line), "%-8s %9u %8.1f %8.1f %8.1f %8.1f", probeNames[i], h.count,
+                 h.count ? h.sumCycles / perUs / h.count : 0.0f,
+                 probePercentileCycles(h, 50) / perUs, probePercentileCycles(h, 99) / perUs,
+                 h.maxCycles / perUs);
+        printLine(line);
+    }
+}
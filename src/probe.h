@@ -0,0 +1,65 @@
+//
+//  Timing probes
+//    PROBE_SCOPE(id) times the rest of the enclosing block in CPU cycles,
+//    PROBE_RECORD_US(id, us) records a duration measured some other way.
+//    Each probe keeps count, sum, max and a histogram of power of 2 buckets:
+//    fixed size, no allocation, a few instructions per record.
+//    A probe must be recorded from one task only (no locking).
+//    Build with -DENABLE_PROBES=0 and the macros compile to nothing.
+//
+#pragma once
+
+#include <stdint.h>
+#include "hal.h"
+
+#ifndef ENABLE_PROBES
+#define ENABLE_PROBES 1
+#endif
+
+enum ProbeId
+{
+    probeLoop,       // Timer callbacks of one loop() pass
+    probeDraw,       // compositorFlush()
+    probeButtons,    // drawButtons()
+    probeRepDraw,    // Rep counter and progress bar redraw
+    probeDetect,     // checkSwichStatus(), one sample (sensor task)
+    probeRepLatency, // Press onset to rep counted on the UI side
+    probeItems
+};
+
+const int probeBuckets = 32; // Bucket i: 2^i ~ 2^(i+1) - 1 cycles
+
+struct ProbeHist
+{
+    uint32_t count;
+    uint32_t maxCycles;
+    uint64_t sumCycles;
+    uint32_t buckets[probeBuckets];
+};
+
+void probeRecord(ProbeId id, uint32_t cycles);
+void probeReset();
+const ProbeHist &probeHist(ProbeId id);
+uint32_t probePercentileCycles(const ProbeHist &hist, int percent);
+void probeReport(void (*printLine)(const char *line));
+
+class ProbeScope
+{
+public:
+    explicit ProbeScope(ProbeId id) : id_(id), start_(halCycleCount()) {}
+    ~ProbeScope() { probeRecord(id_, halCycleCount() - start_); }
+
+private:
+    ProbeId id_;
+    uint32_t start_;
+};
+
+#if ENABLE_PROBES
+#define PROBE_JOIN2(a, b) a##b
+#define PROBE_JOIN(a, b) PROBE_JOIN2(a, b)
+#define PROBE_SCOPE(id) ProbeScope PROBE_JOIN(probeScope, __LINE__)(id)
+#define PROBE_RECORD_US(id, us) probeRecord(id, (uint32_t)(us) * halCyclesPerUs())
+#else
+#define PROBE_SCOPE(id) ((void)0)
+#define PROBE_RECORD_US(id, us) ((void)0)
+#endif
@@ -0,0 +1,43 @@
+//
+//  Rep counting
+//
+
+#include "rep_counter.h"
+
+static CountMode counterMode = countAny;
+static uint32_t counterPressed;  // Bit mask of the pads held down
+static int counterLastSide = -1; // Side of the last counted press, -1: none yet
+
+// Set start
+void repCounterBegin(CountMode mode)
+{
+    counterMode = mode;
+    repCounterBreak();
+}
+
+// Pause: events are not fed while paused, so forget the feet held before it
+void repCounterBreak()
+{
+    counterPressed = 0;
+    counterLastSide = -1;
+}
+
+// Returns true if the event makes a rep
+bool repCounterEvent(const RepEvent &ev)
+{
+    const uint32_t allPads = (uint32_t)((1ULL << sampleChannels) - 1);
+    int side = ev.side;
+
+    if (ev.type != repEventPress)
+    {
+        counterPressed &= ~(1UL << side);
+        return false;
+    }
+    counterPressed |= 1UL << side;
+    if (counterMode == countAlternate && side == counterLastSide)
+        return false;
+    if (counterMode == countBoth && counterPressed != allPads)
+        return false;
+    counterLastSide = side;
+    return true;
+}
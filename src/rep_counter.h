@@ -0,0 +1,23 @@
+//
+//  Rep counting
+//    Decides from the per-side press / release events which presses count as
+//    a rep. Every event is decided when it arrives, so the count follows the
+//    sensor without waiting for the other foot.
+//
+#pragma once
+
+#include <stdint.h>
+#include "sampler.h"
+#include "sensor_task.h"
+
+enum CountMode
+{
+    countAny,       // Every press of any pad
+    countAlternate, // A press counts only after a counted press of another pad
+    countBoth,      // All pads down together, counted when the last one lands
+    countModes
+};
+
+void repCounterBegin(CountMode mode);
+void repCounterBreak();
+bool repCounterEvent(const RepEvent &ev);
@@ -0,0 +1,216 @@
+//
+//  Rep timing analytics
+//
+
+#include <math.h>
+#include <string.h>
+#include "rep_stats.h"
+
+static RepStats setStats;
+static RepStats sessionStats;
+static uint32_t pressStartUs[sampleChannels];
+static bool isPressing[sampleChannels];
+static int lastPressSide = -1; // -1: none since the set start / pause
+static uint32_t lastRepUs;
+static bool isLastRepValid;    // False at the set start and after a pause
+
+void statReset(RunningStat &stat)
+{
+    memset(&stat, 0, sizeof(stat));
+}
+
+void statAdd(RunningStat &stat, uint32_t ms)
+{
+    float delta;
+    uint16_t bin = ms / statBinMs;
+
+    if (stat.count == UINT16_MAX)
+        return;
+    stat.count++;
+    delta = ms - stat.mean;
+    stat.mean += delta / stat.count;
+    stat.m2 += delta * (ms - stat.mean);
+    if (stat.count == 1 || ms < stat.minMs)
+        stat.minMs = ms;
+    if (ms > stat.maxMs)
+        stat.maxMs = ms;
+    stat.bins[bin < statBinCount ? bin : statBinCount - 1]++;
+}
+
+uint32_t statMeanMs(const RunningStat &stat)
+{
+    return (uint32_t)(stat.mean + 0.5f);
+}
+
+uint32_t statStdDevMs(const RunningStat &stat)
+{
+    if (stat.count < 2)
+        return 0;
+    return (uint32_t)(sqrtf(stat.m2 / (stat.count - 1)) + 0.5f);
+}
+
+// Interpolated inside the bin, clamped to the seen min / max
+uint32_t statPercentileMs(const RunningStat &stat, int percent)
+{
+    uint32_t rank = ((uint32_t)stat.count * percent + 99) / 100;
+    uint32_t seen = 0;
+    uint32_t ms;
+
+    if (stat.count == 0)
+        return 0;
+    if (rank == 0)
+        rank = 1;
+    for (uint16_t i = 0; i < statBinCount; i++)
+    {
+        if (seen + stat.bins[i] < rank)
+        {
+            seen += stat.bins[i];
+            continue;
+        }
+        ms = i * statBinMs + statBinMs * (rank - seen) / (stat.bins[i] + 1);
+        if (ms < stat.minMs)
+            ms = stat.minMs;
+        if (ms > stat.maxMs)
+            ms = stat.maxMs;
+        return ms;
+    }
+    return stat.maxMs;
+}
+
+static void repStatsReset(RepStats &stats)
+{
+    statReset(stats.pressMs);
+    statReset(stats.intervalMs);
+    stats.driftSumX = stats.driftSumY = stats.driftSumXY = stats.driftSumXX = 0;
+    for (int side = 0; side < sampleChannels; side++)
+    {
+        stats.sidePresses[side] = stats.sideReleases[side] = stats.sideSteps[side] = 0;
+        stats.sidePressMsSum[side] = stats.sideStepMsSum[side] = 0;
+    }
+}
+
+static void addPress(RepStats &stats, int side, uint32_t stepMs, bool isStep)
+{
+    stats.sidePresses[side]++;
+    if (!isStep)
+        return;
+    stats.sideSteps[side]++;
+    stats.sideStepMsSum[side] += stepMs;
+}
+
+static void addPressDuration(RepStats &stats, int side, uint32_t ms)
+{
+    statAdd(stats.pressMs, ms);
+    stats.sideReleases[side]++;
+    stats.sidePressMsSum[side] += ms;
+}
+
+void repStatsBeginSession()
+{
+    repStatsReset(sessionStats);
+    repStatsBeginSet();
+}
+
+void repStatsBeginSet()
+{
+    repStatsReset(setStats);
+    repStatsBreak();
+}
+
+void repStatsPress(int side, uint32_t timeUs)
+{
+    bool isStep = lastPressSide >= 0 && lastPressSide != side;
+    uint32_t stepMs = isStep ? (timeUs - pressStartUs[lastPressSide]) / 1000 : 0;
+
+    addPress(setStats, side, stepMs, isStep);
+    addPress(sessionStats, side, stepMs, isStep);
+    pressStartUs[side] = timeUs;
+    isPressing[side] = true;
+    lastPressSide = side;
+}
+
+void repStatsRelease(int side, uint32_t timeUs)
+{
+    uint32_t ms;
+
+    if (!isPressing[side])
+        return;
+    isPressing[side] = false;
+    ms = (timeUs - pressStartUs[side]) / 1000;
+    addPressDuration(setStats, side, ms);
+    addPressDuration(sessionStats, side, ms);
+}
+
+static void addInterval(RepStats &stats, uint32_t ms)
+{
+    float x;
+
+    statAdd(stats.intervalMs, ms);
+    x = stats.intervalMs.count;
+    stats.driftSumX += x;
+    stats.driftSumY += ms;
+    stats.driftSumXY += x * ms;
+    stats.driftSumXX += x * x;
+}
+
+// timeUs: sample time of the press that made the rep
+void repStatsRep(uint32_t timeUs)
+{
+    if (isLastRepValid)
+    {
+        addInterval(setStats, (timeUs - lastRepUs) / 1000);
+        addInterval(sessionStats, (timeUs - lastRepUs) / 1000);
+    }
+    lastRepUs = timeUs;
+    isLastRepValid = true;
+}
+
+// Timing across a pause is not a rep interval, and a foot held during it is not a press
+void repStatsBreak()
+{
+    isLastRepValid = false;
+    for (int side = 0; side < sampleChannels; side++)
+        isPressing[side] = false;
+    lastPressSide = -1;
+}
+
+// Change of the rep interval per rep (+: slowing down)
+int32_t repStatsDriftMs(const RepStats &stats)
+{
+    float n = stats.intervalMs.count;
+    float den = n * stats.driftSumXX - stats.driftSumX * stats.driftSumX;
+
+    if (n < 3 || den == 0)
+        return 0;
+    return (int32_t)lroundf((n * stats.driftSumXY - stats.driftSumX * stats.driftSumY) / den);
+}
+
+// Left mean - right mean, 0 until both sides have data
+static int32_t sideAsymMs(const uint32_t *sum, const uint16_t *count)
+{
+    if (count[0] == 0 || count[1] == 0)
+        return 0;
+    return (int32_t)(sum[1] / count[1]) - (int32_t)(sum[0] / count[0]);
+}
+
+// Press duration, left - right
+int32_t repStatsPressAsymMs(const RepStats &stats)
+{
+    return sideAsymMs(stats.sidePressMsSum, stats.sideReleases);
+}
+
+// Step time onto the left foot - onto the right foot (from any other pad)
+int32_t repStatsStepAsymMs(const RepStats &stats)
+{
+    return sideAsymMs(stats.sideStepMsSum, stats.sideSteps);
+}
+
+const RepStats &repStatsSet()
+{
+    return setStats;
+}
+
+const RepStats &repStatsSession()
+{
+    return sessionStats;
+}
@@ -0,0 +1,60 @@
+//
+//  Rep timing analytics
+//    Press duration and time between reps from the sensor event timestamps,
+//    kept per set and per session. Every update is O(1) and the memory is
+//    fixed: running mean / variance (Welford), min / max, and a histogram of
+//    fixed bins for percentiles. Cadence drift is the least squares slope of
+//    the rep interval over the rep number.
+//    Balance: presses, press duration and step time (from a press of another
+//    pad) per channel; the asymmetry compares the left and right foot pads.
+//
+#pragma once
+
+#include <stdint.h>
+#include "sampler.h"
+
+const uint16_t statBinCount = 64;
+const uint16_t statBinMs = 40;    // 64 x 40ms: 0 ~ 2.56s, longer goes to the last bin
+
+struct RunningStat
+{
+    uint16_t count;
+    float mean;
+    float m2;                      // Sum of squared differences from the mean
+    uint32_t minMs;
+    uint32_t maxMs;
+    uint16_t bins[statBinCount];
+};
+
+struct RepStats
+{
+    RunningStat pressMs;           // Press to release of a foot
+    RunningStat intervalMs;        // Counted rep to the next counted rep
+    float driftSumX;               // Least squares sums, x: rep number, y: interval
+    float driftSumY;
+    float driftSumXY;
+    float driftSumXX;
+    uint16_t sidePresses[sampleChannels];    // 0:Right, 1:Left, ...
+    uint16_t sideReleases[sampleChannels];   // Presses with a duration
+    uint32_t sidePressMsSum[sampleChannels];
+    uint16_t sideSteps[sampleChannels];      // Presses that followed a press of another pad
+    uint32_t sideStepMsSum[sampleChannels];
+};
+
+void statReset(RunningStat &stat);
+void statAdd(RunningStat &stat, uint32_t ms);
+uint32_t statMeanMs(const RunningStat &stat);
+uint32_t statStdDevMs(const RunningStat &stat);
+uint32_t statPercentileMs(const RunningStat &stat, int percent);
+
+void repStatsBeginSession();
+void repStatsBeginSet();
+void repStatsPress(int side, uint32_t timeUs);
+void repStatsRelease(int side, uint32_t timeUs);
+void repStatsRep(uint32_t timeUs);
+void repStatsBreak();
+int32_t repStatsDriftMs(const RepStats &stats);
+int32_t repStatsPressAsymMs(const RepStats &stats);
+int32_t repStatsStepAsymMs(const RepStats &stats);
+const RepStats &repStatsSet();
+const RepStats &repStatsSession();
@@ -0,0 +1,47 @@
+//
+//  Sensor sampler
+//    HAL periodic timer -> single producer / single consumer ring buffer
+//
+
+#include "hal.h"
+#include "spsc_queue.h"
+#include "sampler.h"
+#include "sensor_transport.h"
+
+static SpscQueue<AdcSample, sampleBufferSize> sampleBuffer;
+
+// Runs in the timer context. When the buffer is full, the new sample is dropped
+// so the consumer never sees a torn entry.
+static void samplerTick()
+{
+    AdcSample s;
+
+    s.timeUs = halMicros();
+    for (int ch = 0; ch < sampleChannels; ch++)
+        s.value[ch] = halAdcRead(ch);
+    sampleBuffer.push(s);
+}
+
+void samplerBegin(const uint16_t *pins)
+{
+    halAdcBegin(pins, sampleChannels);
+    halTimerStartPeriodic(1000000 / sampleRateHz, samplerTick);
+}
+
+// Discard everything sampled so far
+void samplerFlush()
+{
+    sampleBuffer.clear();
+}
+
+bool samplerRead(AdcSample &sample)
+{
+    return sampleBuffer.pop(sample);
+}
+
+uint32_t samplerOverruns()
+{
+    return sampleBuffer.dropped();
+}
+
+const SensorTransport sensorLocal = {"local", samplerBegin, samplerRead, samplerOverruns};
@@ -0,0 +1,30 @@
+//
+//  Sensor sampler
+//    Samples the sensor ADC inputs at a fixed rate from a timer and keeps
+//    the results with timestamps in a ring buffer.
+//    Detection logic drains the buffer instead of calling analogRead(),
+//    so sampling keeps going while the screen draws or a beep plays.
+//
+#pragma once
+
+#include <stdint.h>
+
+// Sensor pads, one ADC pin each. The index is the channel (event side) number.
+// 0 and 1 are the right / left foot pads; more pads (hands, stations) follow them.
+const uint16_t sensorPins[] = {35, 36};
+const uint16_t sampleChannels = sizeof(sensorPins) / sizeof(sensorPins[0]);
+const uint32_t sampleRateHz = 1000;     // 1kHz
+const uint16_t sampleBufferSize = 256;  // Must be power of 2. 256 samples = 256ms at 1kHz
+
+static_assert(sampleChannels >= 2 && sampleChannels <= 32, "Two foot pads needed, at most 32 channels (bit masks)");
+
+struct AdcSample
+{
+    uint32_t timeUs;                 // Sampled time (micros)
+    uint16_t value[sampleChannels];  // Raw ADC values (0 ~ 4095)
+};
+
+void samplerBegin(const uint16_t *pins);
+void samplerFlush();
+bool samplerRead(AdcSample &sample);
+uint32_t samplerOverruns();
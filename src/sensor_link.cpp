@@ -0,0 +1,454 @@
+//
+//  Sensor link
+//    Datagrams -> reorder window -> samples in node time -> halMicros() time.
+//    All receiver state belongs to the sensor task.
+//
+
+#include <string.h>
+#include "hal.h"
+#include "sensor_link.h"
+
+const uint32_t linkPeriodUs = 1000000 / sampleRateHz;
+
+struct LinkSlot
+{
+    bool isFull;
+    uint16_t sequence;
+    uint8_t count;
+    uint32_t arrivalUs;
+    AdcSample samples[telemetryBatch];
+};
+
+struct LinkSync
+{
+    uint32_t rttUs;
+    uint32_t offsetUs; // Receiver - node time, mod 2^32
+    uint32_t nodeUs;   // t2
+};
+
+static LinkSlot linkSlots[linkWindow];
+static int linkWaiting;        // Full slots
+static bool isLinkStarted;     // First packet seen, linkNextSeq valid
+static uint16_t linkNextSeq;   // Packet to deliver next
+static uint16_t linkNewestSeq; // Newest packet received, and the node time of its first sample
+static uint32_t linkNewestNodeUs;
+static uint32_t linkHold = linkHoldUs;
+
+// The node before its last restart: what it sent before is still on the way
+static bool hasLinkPrevious;
+static uint16_t linkPreviousSeq;
+static uint32_t linkPreviousNodeUs;
+static uint32_t linkPreviousOffsetUs;
+
+static AdcSample linkOut[telemetryBatch]; // Packet being delivered, node time
+static int linkOutCount;
+static int linkOutPos;
+static AdcSample linkLast;     // Last sample delivered, node time
+static bool hasLinkLast;
+static int linkConcealLeft;
+static uint32_t linkLastLocalUs;
+
+static LinkSync linkSyncs[linkSyncWindow];
+static int linkSyncCount;
+static int linkSyncPos;
+static uint32_t linkSyncSentUs;
+static uint32_t linkServiceUs; // Last look at the link
+static uint32_t linkOffsetUs;  // Receiver - node time at linkRefNodeUs
+static uint32_t linkRefNodeUs;
+static int32_t linkSkewQ24;    // Offset change per node us, Q8.24
+static bool hasLinkSkew;
+static LinkSync linkSkewBase;  // Pick the next skew estimate is measured from
+
+static SensorLinkStats linkStats;
+
+static uint8_t *put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static size_t linkSeal(uint8_t *packet, uint8_t *p)
+{
+    uint16_t crc = telemetryCrc16(packet, p - packet);
+
+    *p++ = crc;
+    *p++ = crc >> 8;
+    return p - packet;
+}
+
+static bool linkCheck(const uint8_t *packet, size_t len, uint8_t type, size_t expected)
+{
+    return len == expected && packet[0] == type &&
+           telemetryCrc16(packet, len - 2) == (packet[len - 2] | packet[len - 1] << 8);
+}
+
+static void linkRestart();
+
+static bool linkIsJump(int32_t jumpUs)
+{
+    return jumpUs > (int32_t)linkRestartUs || jumpUs < -(int32_t)linkRestartUs;
+}
+
+//---- Clock
+
+static void linkSyncReset()
+{
+    linkSyncCount = 0;
+    linkSyncPos = 0;
+    linkSkewQ24 = 0;
+    hasLinkSkew = false;
+    linkStats.synced = false;
+    linkStats.skewPpm = 0;
+}
+
+static uint32_t linkToLocal(uint32_t nodeUs)
+{
+    int64_t sinceRef = (int32_t)(nodeUs - linkRefNodeUs);
+
+    return nodeUs + linkOffsetUs + (int32_t)((sinceRef * linkSkewQ24) >> 24);
+}
+
+// New estimate from the skew base to the pick, smoothed over a few spans
+static void linkSkewUpdate(const LinkSync &pick)
+{
+    int32_t span = pick.nodeUs - linkSkewBase.nodeUs;
+    int32_t maxQ24 = ((int64_t)linkSkewMaxPpm << 24) / 1000000;
+    int32_t est;
+
+    if (span < (int32_t)linkSkewSpanUs)
+        return;
+    est = ((int64_t)(int32_t)(pick.offsetUs - linkSkewBase.offsetUs) << 24) / span;
+    est = est > maxQ24 ? maxQ24 : est < -maxQ24 ? -maxQ24 : est;
+    linkSkewQ24 = hasLinkSkew ? linkSkewQ24 + (est - linkSkewQ24) / 4 : est;
+    hasLinkSkew = true;
+    linkSkewBase = pick;
+    linkStats.skewPpm = ((int64_t)linkSkewQ24 * 1000000) >> 24;
+}
+
+static void linkSyncReply(const uint8_t *packet, uint32_t t3)
+{
+    uint32_t t0 = get32(packet + 1);
+    uint32_t t1 = get32(packet + 5);
+    uint32_t t2 = get32(packet + 9);
+    uint32_t d1 = t0 - t1;
+    int32_t rtt = (t3 - t0) - (t2 - t1);
+    LinkSync sync = {rtt > 0 ? (uint32_t)rtt : 0, d1 + (int32_t)((t3 - t2) - d1) / 2, t2};
+    const LinkSync *best = &sync;
+    bool isJump = linkStats.synced && linkIsJump(sync.offsetUs - (linkToLocal(t2) - t2));
+
+    if ((isJump || !linkStats.synced) && hasLinkPrevious && !linkIsJump(sync.offsetUs - linkPreviousOffsetUs))
+        return; // Answered before the restart
+    if (isJump)
+        linkRestart(); // The node's clock started over
+    linkSyncs[linkSyncPos] = sync;
+    linkSyncPos = (linkSyncPos + 1) % linkSyncWindow;
+    if (linkSyncCount < linkSyncWindow)
+        linkSyncCount++;
+    for (int i = 0; i < linkSyncCount; i++)
+    {
+        if (linkSyncs[i].rttUs < best->rttUs)
+            best = &linkSyncs[i];
+    }
+    linkStats.syncs++;
+    if (linkStats.synced && best->nodeUs == linkRefNodeUs)
+        return; // Same pick as before
+    if (!linkStats.synced)
+        linkSkewBase = *best;
+    else
+        linkSkewUpdate(*best);
+    linkOffsetUs = best->offsetUs;
+    linkRefNodeUs = best->nodeUs;
+    linkStats.rttUs = best->rttUs;
+    linkStats.synced = true;
+}
+
+//---- Receiving
+
+static void linkReset()
+{
+    for (int i = 0; i < linkWindow; i++)
+        linkSlots[i].isFull = false;
+    linkWaiting = 0;
+    isLinkStarted = false;
+    linkOutCount = linkOutPos = 0;
+    hasLinkLast = false;
+    linkConcealLeft = 0;
+    linkSyncReset();
+}
+
+static void linkRestart()
+{
+    hasLinkPrevious = true;
+    linkPreviousSeq = linkNewestSeq;
+    linkPreviousNodeUs = linkNewestNodeUs;
+    linkPreviousOffsetUs = linkOffsetUs;
+    linkReset();
+    linkStats.restarts++;
+}
+
+// Node time of a packet against the one its sequence puts it at in a stream
+static int32_t linkJumpUs(const TelemetryHeader &header, uint32_t timeUs, uint16_t seq, uint32_t nodeUs)
+{
+    int16_t newer = header.sequence - seq;
+
+    return timeUs - nodeUs - newer * (int32_t)(header.count * linkPeriodUs);
+}
+
+static void linkGiveUp()
+{
+    LinkSlot &slot = linkSlots[linkNextSeq & (linkWindow - 1)];
+
+    if (slot.isFull && slot.sequence == linkNextSeq)
+    {
+        slot.isFull = false;
+        linkWaiting--;
+    }
+    linkStats.lost++;
+    linkNextSeq++;
+}
+
+static void linkSamples(const uint8_t *packet, size_t len, uint32_t nowUs)
+{
+    TelemetryHeader header;
+    AdcSample samples[telemetryBatch];
+    int16_t ahead;
+    bool isJump;
+
+    if (!telemetryUnpack(packet, len, header, samples))
+    {
+        linkStats.bad++;
+        return;
+    }
+    // A restarted node starts its sequence and clock over, so its sequence can't
+    // be compared with linkNextSeq any more
+    isJump = isLinkStarted && linkIsJump(linkJumpUs(header, samples[0].timeUs, linkNewestSeq, linkNewestNodeUs));
+    if ((isJump || !isLinkStarted) && hasLinkPrevious &&
+        !linkIsJump(linkJumpUs(header, samples[0].timeUs, linkPreviousSeq, linkPreviousNodeUs)))
+    {
+        linkStats.late++; // Sent before the restart
+        return;
+    }
+    if (isJump)
+        linkRestart();
+    if (!isLinkStarted)
+    {
+        isLinkStarted = true;
+        linkNextSeq = linkNewestSeq = header.sequence;
+        linkNewestNodeUs = samples[0].timeUs;
+    }
+    if ((int16_t)(header.sequence - linkNewestSeq) > 0)
+    {
+        linkNewestSeq = header.sequence;
+        linkNewestNodeUs = samples[0].timeUs;
+    }
+    ahead = header.sequence - linkNextSeq;
+    if (ahead < 0)
+    {
+        linkStats.late++;
+        return;
+    }
+    while (ahead >= linkWindow) // No room: the oldest ones won't come any more
+    {
+        linkGiveUp();
+        ahead--;
+    }
+
+    LinkSlot &slot = linkSlots[header.sequence & (linkWindow - 1)];
+    if (slot.isFull)
+    {
+        linkStats.late++;
+        return;
+    }
+    slot.isFull = true;
+    slot.sequence = header.sequence;
+    slot.count = header.count;
+    slot.arrivalUs = nowUs;
+    memcpy(slot.samples, samples, header.count * sizeof(AdcSample));
+    linkWaiting++;
+    linkStats.packets++;
+    linkStats.nodeDropped = header.dropped;
+    if (!linkStats.synced && linkSyncCount == 0)
+    {
+        // Until the first sync: as if the last sample had arrived without delay
+        linkOffsetUs = nowUs - samples[header.count - 1].timeUs;
+        linkRefNodeUs = samples[header.count - 1].timeUs;
+    }
+}
+
+// Datagrams that arrived, and the sync request when due
+static void linkService()
+{
+    uint8_t packet[telemetryPacketMax];
+    uint32_t len;
+    uint32_t nowUs = halMicros();
+    // A reply came in some time since the last look: the middle halves the error
+    // and takes the bias of a late look off the offset
+    uint32_t arrivedUs = nowUs - (nowUs - linkServiceUs) / 2;
+
+    linkServiceUs = nowUs;
+    while ((len = halLinkReceive(packet, sizeof(packet))) > 0)
+    {
+        if (packet[0] == telemetryTypeSamples)
+            linkSamples(packet, len, nowUs);
+        else if (linkCheck(packet, len, linkMsgSyncReply, linkSyncReplyLen))
+            linkSyncReply(packet, arrivedUs);
+        else
+            linkStats.bad++;
+    }
+    if (isLinkStarted && nowUs - linkSyncSentUs >= linkSyncIntervalUs)
+    {
+        uint8_t *p = packet;
+
+        *p++ = linkMsgSyncRequest;
+        p = put32(p, nowUs);
+        halLinkSend(packet, linkSeal(packet, p));
+        linkSyncSentUs = nowUs;
+    }
+}
+
+// Moves the next packet in sequence to linkOut, or gives up on it once a later
+// one has waited the hold time. False: nothing to deliver yet.
+static bool linkTakeNext()
+{
+    LinkSlot &slot = linkSlots[linkNextSeq & (linkWindow - 1)];
+    uint32_t nowUs = halMicros();
+    int32_t gapUs;
+
+    if (linkWaiting == 0)
+        return false;
+    if (!slot.isFull || slot.sequence != linkNextSeq)
+    {
+        for (int i = 0; i < linkWindow; i++)
+        {
+            if (linkSlots[i].isFull && nowUs - linkSlots[i].arrivalUs >= linkHold)
+            {
+                linkGiveUp();
+                return true;
+            }
+        }
+        return false;
+    }
+    memcpy(linkOut, slot.samples, slot.count * sizeof(AdcSample));
+    linkOutCount = slot.count;
+    linkOutPos = 0;
+    slot.isFull = false;
+    linkWaiting--;
+    linkNextSeq++;
+
+    gapUs = linkOut[0].timeUs - linkLast.timeUs;
+    if (hasLinkLast && gapUs > (int32_t)linkPeriodUs * 3 / 2)
+    {
+        int missing = (gapUs + linkPeriodUs / 2) / linkPeriodUs - 1;
+        if (missing <= linkConcealMax)
+            linkConcealLeft = missing;
+    }
+    return true;
+}
+
+// In receiver time, never earlier than the sample before
+static bool linkEmit(const AdcSample &nodeSample, AdcSample &sample)
+{
+    sample = nodeSample;
+    sample.timeUs = linkToLocal(nodeSample.timeUs);
+    if (hasLinkLast && (int32_t)(sample.timeUs - linkLastLocalUs) <= 0)
+        sample.timeUs = linkLastLocalUs + 1;
+    linkLastLocalUs = sample.timeUs;
+    hasLinkLast = true;
+    return true;
+}
+
+static bool linkNext(AdcSample &sample)
+{
+    for (;;)
+    {
+        if (linkConcealLeft > 0)
+        {
+            linkConcealLeft--;
+            linkLast.timeUs += linkPeriodUs;
+            linkStats.concealed++;
+            return linkEmit(linkLast, sample);
+        }
+        if (linkOutPos < linkOutCount)
+        {
+            linkLast = linkOut[linkOutPos++];
+            return linkEmit(linkLast, sample);
+        }
+        if (!linkTakeNext())
+            return false;
+    }
+}
+
+static void linkBegin(const uint16_t *pins)
+{
+    memset(&linkStats, 0, sizeof(linkStats));
+    linkReset();
+    hasLinkPrevious = false;
+    linkSyncSentUs = halMicros() - linkSyncIntervalUs;
+    linkServiceUs = halMicros();
+    halLinkBegin(linkSsid, linkPassword, linkPort);
+}
+
+static bool linkRead(AdcSample &sample)
+{
+    if (linkNext(sample))
+        return true;
+    linkService();
+    return linkNext(sample);
+}
+
+static uint32_t linkLost()
+{
+    return linkStats.concealed + linkStats.nodeDropped;
+}
+
+const SensorTransport sensorRemote = {"remote", linkBegin, linkRead, linkLost};
+
+void sensorLinkSetHold(uint32_t holdUs)
+{
+    linkHold = holdUs;
+}
+
+void sensorLinkStats(SensorLinkStats &stats)
+{
+    stats = linkStats;
+}
+
+//---- Node
+
+void sensorNodeBegin(SensorLinkNode &node, int batch)
+{
+    node.count = 0;
+    node.batch = batch < 1 ? 1 : batch > telemetryBatch ? telemetryBatch : batch;
+    node.sequence = 0;
+    node.dropped = 0;
+}
+
+size_t sensorNodePush(SensorLinkNode &node, const AdcSample &sample, uint8_t *packet)
+{
+    node.samples[node.count++] = sample;
+    if (node.count < node.batch)
+        return 0;
+    node.count = 0;
+    return telemetryPackSamples(node.samples, node.batch, node.sequence++, node.dropped, packet);
+}
+
+size_t sensorNodeReply(const uint8_t *request, size_t len, uint32_t rxUs, uint32_t txUs, uint8_t *reply)
+{
+    uint8_t *p = reply;
+
+    if (!linkCheck(request, len, linkMsgSyncRequest, linkSyncRequestLen))
+        return 0;
+    *p++ = linkMsgSyncReply;
+    p = put32(p, get32(request + 1));
+    p = put32(p, rxUs);
+    p = put32(p, txUs);
+    return linkSeal(reply, p);
+}
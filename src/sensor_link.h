@@ -0,0 +1,89 @@
+//
+//  Sensor link
+//    Pads on a wireless knee-sensor node instead of the local ADC pins.
+//    The node samples at sampleRateHz on its own clock and sends batches of
+//    samples as telemetry packets (telemetry.h: sequence, time of the first
+//    sample, deltas, CRC), one per datagram, no COBS.
+//    The receiver puts the packets back in sequence order, waits up to the hold
+//    time for a missing one, fills a lost stretch with the last value (the
+//    detector counts samples) and maps node time to halMicros() time.
+//
+//    Clock sync, little endian, CRC-16 as telemetry:
+//      request  u8 linkMsgSyncRequest, u32 t0 (sent, receiver clock), u16 CRC
+//      reply    u8 linkMsgSyncReply, u32 t0, u32 t1 (received, node clock),
+//               u32 t2 (replied, node clock), u16 CRC
+//    With t3 the time the reply arrived: offset = ((t0 - t1) + (t3 - t2)) / 2,
+//    round trip = (t3 - t0) - (t2 - t1). Of the last linkSyncWindow exchanges the
+//    one with the shortest round trip is used (least queueing, least asymmetry),
+//    and the change of offset between picks far apart gives the clock skew.
+//
+//    A node that restarts begins again at sequence 0 on a clock near 0. The
+//    receiver sees it as a packet whose node time is off by more than
+//    linkRestartUs from what its sequence says (against the newest packet), or a
+//    sync reply that moves the offset that much, and starts over. Packets and
+//    replies still on the way from before the restart are dropped.
+//
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sampler.h"
+#include "telemetry.h"
+#include "sensor_transport.h"
+
+const char linkSsid[] = "training-sensor";
+const char linkPassword[] = "kneesensor";
+const uint16_t linkPort = 47801;
+const uint8_t linkMsgSyncRequest = 2; // 1 is telemetryTypeSamples
+const uint8_t linkMsgSyncReply = 3;
+const int linkSyncRequestLen = 7;
+const int linkSyncReplyLen = 15;
+const int linkNodeBatch = 8;                 // Samples per packet on the node: 8ms at 1kHz
+const int linkWindow = 32;                   // Packets held for reordering, power of 2
+const uint32_t linkHoldUs = 20000;           // Wait for a missing packet before it's lost
+const uint32_t linkSyncIntervalUs = 500000;  // Sync request period
+const int linkSyncWindow = 8;                // Exchanges the best one is picked from
+const uint32_t linkSkewSpanUs = 20000000;    // Node time between picks for a skew estimate
+const int32_t linkSkewMaxPpm = 200;          // More is noise, not a crystal
+const int linkConcealMax = 250;              // Longest gap filled in (samples), longer: time jumps
+const uint32_t linkRestartUs = 1000000;      // Node clock jump taken for a node restart
+
+static_assert((linkWindow & (linkWindow - 1)) == 0, "linkWindow must be a power of 2");
+static_assert(linkNodeBatch <= telemetryBatch, "A node batch is one telemetry packet");
+
+struct SensorLinkStats
+{
+    uint32_t packets;     // Valid sample packets
+    uint32_t bad;         // Bad CRC or layout
+    uint32_t lost;        // Packets given up on after the hold time
+    uint32_t late;        // Arrived after being given up on, twice, or from before a node restart
+    uint32_t concealed;   // Samples filled in for lost ones
+    uint32_t restarts;    // Node restarts seen
+    uint16_t nodeDropped; // Samples the node dropped itself (wraps)
+    uint32_t syncs;       // Sync replies received
+    uint32_t rttUs;       // Round trip of the exchange in use
+    int32_t skewPpm;      // Node clock slower (+) / faster (-) than ours
+    bool synced;
+};
+
+//---- Receiver (sensorRemote runs it in the sensor task)
+void sensorLinkSetHold(uint32_t holdUs);
+void sensorLinkStats(SensorLinkStats &stats);
+
+//---- Node: batches samples into packets, answers sync requests
+struct SensorLinkNode
+{
+    AdcSample samples[telemetryBatch];
+    int count;
+    int batch;
+    uint16_t sequence;
+    uint16_t dropped;
+};
+
+void sensorNodeBegin(SensorLinkNode &node, int batch);
+// Adds a sample stamped in node time. A full batch is packed into
+// packet[telemetryPacketMax] and its length returned, else 0.
+size_t sensorNodePush(SensorLinkNode &node, const AdcSample &sample, uint8_t *packet);
+// Reply[linkSyncReplyLen] to a sync request received at rxUs, sent at txUs (node time).
+// 0: not a sync request.
+size_t sensorNodeReply(const uint8_t *request, size_t len, uint32_t rxUs, uint32_t txUs, uint8_t *reply);
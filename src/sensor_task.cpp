@@ -0,0 +1,55 @@
+//
+//  Sensor task
+//
+
+#include "hal.h"
+#include "detection.h"
+#include "sensor_task.h"
+#include "probe.h"
+#include "telemetry.h"
+
+SpscQueue<RepEvent, 64> repEvents;
+Detection sensorDetection;
+
+static const SensorTransport *sensorTransport = &sensorLocal;
+static uint8_t sensorStatus[sampleChannels];
+
+// Drain the transport and turn status changes into events
+void sensorPoll()
+{
+    AdcSample sample;
+    uint32_t edgeUs[sampleChannels];
+
+    while (sensorTransport->read(sample))
+    {
+        uint32_t changed;
+
+        telemetryPush(sample);
+        {
+            PROBE_SCOPE(probeDetect);
+            changed = checkSwichStatus(sensorDetection, sensorStatus, sample, edgeUs);
+        }
+        while (changed != 0) // Only the channels that changed
+        {
+            int side = __builtin_ctz(changed);
+            uint32_t latencyUs = sample.timeUs - edgeUs[side];
+            RepEvent ev = {edgeUs[side], (uint8_t)side,
+                           sensorStatus[side] ? repEventPress : repEventRelease,
+                           (uint16_t)(latencyUs < 0xffff ? latencyUs : 0xffff)};
+            repEvents.push(ev);
+            changed &= changed - 1;
+        }
+    }
+}
+
+void sensorTaskBegin(const SensorTransport &transport, const uint16_t *pins)
+{
+    sensorTransport = &transport;
+    sensorTransport->begin(pins);
+    halTaskStartPeriodic("sensor", sensorPoll, sensorPollInterval, sensorTaskCore);
+}
+
+uint32_t sensorLost()
+{
+    return sensorTransport->lost();
+}
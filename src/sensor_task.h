@@ -0,0 +1,33 @@
+//
+//  Sensor task
+//    Sensor acquisition and rep detection, running on core 0.
+//    Results go to the UI (core 1) as timestamped events through a lock-free
+//    queue, so a slow screen update or beep can't delay or drop a rep.
+//
+#pragma once
+
+#include <stdint.h>
+#include "spsc_queue.h"
+#include "detection.h"
+#include "sensor_transport.h"
+
+const uint32_t sensorPollInterval = 2; // Sensor task period: 2ms
+const int sensorTaskCore = 0;
+
+const uint8_t repEventRelease = 0;
+const uint8_t repEventPress = 1;
+
+struct RepEvent
+{
+    uint32_t timeUs;    // Sample time the change started (onset, before filtering)
+    uint8_t side;       // Channel, 0:Right, 1:Left (sampler.h)
+    uint8_t type;       // repEventPress / repEventRelease
+    uint16_t latencyUs; // timeUs to the sample where it was detected
+};
+
+extern SpscQueue<RepEvent, 64> repEvents;
+extern Detection sensorDetection; // detectionBegin() it before sensorTaskBegin()
+
+void sensorTaskBegin(const SensorTransport &transport, const uint16_t *pins);
+void sensorPoll();
+uint32_t sensorLost(); // Lost samples of the transport in use
@@ -0,0 +1,27 @@
+//
+//  Sensor transport
+//    Where the sensor task gets its samples from: the pads wired to the local
+//    ADC pins (sampler.h), or a wireless knee-sensor node (sensor_link.h).
+//    Either way samples come out in time order, stamped in the halMicros() clock,
+//    at sampleRateHz, so the detector can't tell them apart.
+//    Build with -DSENSOR_REMOTE=1 to read the pads from the node.
+//
+#pragma once
+
+#include <stdint.h>
+#include "sampler.h"
+
+#ifndef SENSOR_REMOTE
+#define SENSOR_REMOTE 0
+#endif
+
+struct SensorTransport
+{
+    const char *name;
+    void (*begin)(const uint16_t *pins); // pins: local ADC only
+    bool (*read)(AdcSample &sample);     // Sensor task, false: nothing yet
+    uint32_t (*lost)();                  // Samples the detector never got as sampled
+};
+
+extern const SensorTransport sensorLocal;  // sampler.cpp
+extern const SensorTransport sensorRemote; // sensor_link.cpp
@@ -0,0 +1,123 @@
+//
+//  Settings schema
+//    One table describes every user setting: menu name, selectable values and default.
+//    Value tables, validation bounds, the stored payload layout and the setting menu
+//    are all derived from it at compile time. The tables live in flash, so adding a
+//    setting costs one payload byte and no RAM.
+//
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "settings_store.h"
+#include "rep_counter.h"
+
+enum SettingId
+{
+    settingSets,
+    settingReps,
+    settingRest,
+    settingVolume,
+    settingMode,
+    settingProgram,
+    settingItems // Number of settings in the menu
+};
+
+struct SettingDesc
+{
+    const char *name;          // Menu entry
+    const uint16_t *values;    // Selectable values, stored as index into this table
+    const char *const *labels; // Menu text of the values, NULL: the number
+    uint8_t count;             // Number of values
+    uint8_t defaultIndex;
+};
+
+template <size_t N>
+constexpr SettingDesc makeSetting(const char *name, const uint16_t (&values)[N], uint8_t defaultIndex)
+{
+    return SettingDesc{name, values, NULL, (uint8_t)N, defaultIndex};
+}
+
+template <size_t N>
+constexpr SettingDesc makeSetting(const char *name, const uint16_t (&values)[N],
+                                  const char *const (&labels)[N], uint8_t defaultIndex)
+{
+    return SettingDesc{name, values, labels, (uint8_t)N, defaultIndex};
+}
+
+constexpr uint16_t settingSetsValues[] = {3, 4, 5};
+constexpr uint16_t settingRepsValues[] = {15, 20, 25, 30, 35, 40};
+constexpr uint16_t settingRestValues[] = {30, 45, 60};       // seconds
+constexpr uint16_t settingVolumeValues[] = {0, 2, 4, 6, 8, 10};
+constexpr uint16_t settingModeValues[] = {countAny, countAlternate, countBoth};
+constexpr const char *settingModeLabels[] = {"Any", "Alt", "Both"};
+// 0: Sets / Reps / Rest / Mode above, then workout_programs.h, then the SD card slots.
+// The built-in ones show their program name (drawSettingValues()), not the label here.
+constexpr uint16_t settingProgramValues[] = {0, 1, 2, 3, 4, 5};
+constexpr const char *settingProgramLabels[] = {"Own", "", "", "", "SD 1", "SD 2"};
+
+constexpr SettingDesc settingSchema[settingItems] = {
+    makeSetting("Sets", settingSetsValues, 0),     // 3 sets
+    makeSetting("Reps", settingRepsValues, 1),     // 20 reps
+    makeSetting("Rest", settingRestValues, 1),     // 45 seconds
+    makeSetting("Volume", settingVolumeValues, 2), // level 4
+    makeSetting("Mode", settingModeValues, settingModeLabels, 0), // Any foot
+    makeSetting("Program", settingProgramValues, settingProgramLabels, 0), // Own
+};
+
+//---- Stored payload layout (settingsSchemaVersion 3)
+//    [0 .. settingItems - 1]  value index of each setting, in SettingId order
+//    [settingsCalibrationOffset]      Right sensor idle level / 16, 0: not calibrated
+//    [settingsCalibrationOffset + 1]  Left sensor idle level / 16, 0: not calibrated
+const uint8_t settingsCalibrationOffset = settingItems;
+const uint8_t settingsCalibrationChannels = 2; // Foot pads only, others calibrate at every start
+const uint8_t settingsLayoutSize = settingsCalibrationOffset + settingsCalibrationChannels;
+const uint8_t settingsMenuRows = 6; // Value rows that fit on the setting screen
+
+constexpr bool settingsSchemaOk(int i)
+{
+    return i >= settingItems ||
+           (settingSchema[i].count > 0 && settingSchema[i].count <= settingsMenuRows &&
+            settingSchema[i].defaultIndex < settingSchema[i].count && settingsSchemaOk(i + 1));
+}
+
+static_assert(settingsSchemaOk(0), "Setting table has an empty list, a bad default or too many values");
+static_assert(settingsLayoutSize <= settingsPayloadSize, "Settings do not fit the record payload");
+
+inline uint16_t settingValue(const uint8_t *payload, SettingId id)
+{
+    return settingSchema[id].values[payload[id]];
+}
+
+inline bool isSettingsOk(const uint8_t *payload)
+{
+    for (int i = 0; i < settingItems; i++)
+    {
+        if (payload[i] >= settingSchema[i].count)
+            return false;
+    }
+    return true;
+}
+
+// Bring a payload stored with an older schema version to this layout
+inline void migrateSettings(uint8_t *payload, uint8_t version)
+{
+    if (version < 2) // Version 2 added settingMode in front of the calibration
+    {
+        memmove(payload + settingMode + 1, payload + settingMode, settingsPayloadSize - settingMode - 1);
+        payload[settingMode] = settingSchema[settingMode].defaultIndex;
+    }
+    if (version < 3) // Version 3 added settingProgram in front of the calibration
+    {
+        memmove(payload + settingProgram + 1, payload + settingProgram,
+                settingsPayloadSize - settingProgram - 1);
+        payload[settingProgram] = settingSchema[settingProgram].defaultIndex;
+    }
+}
+
+inline void setSettingsDefault(uint8_t *payload)
+{
+    for (int i = 0; i < settingsPayloadSize; i++)
+        payload[i] = i < settingItems ? settingSchema[i].defaultIndex : 0;
+}
@@ -0,0 +1,199 @@
+//
+//  Settings store
+//
+
+#include <stddef.h>
+#include <string.h>
+#include "hal.h"
+#include "settings_store.h"
+
+const uint8_t settingsMagic = 0xa5;
+
+struct SettingsRecord // 16 bytes, one flash slot
+{
+    uint8_t magic;    // settingsMagic, 0xff: empty slot
+    uint8_t version;  // settingsSchemaVersion
+    uint16_t seq;     // Sequence number, newer record has larger (wrapping) number
+    uint8_t payload[settingsPayloadSize];
+    uint32_t crc;     // CRC32 of the bytes above
+};
+static_assert(sizeof(SettingsRecord) == 16, "Settings record must fit a 16 byte slot");
+
+static uint32_t storeSize = 0;   // Region size, 0: no region
+static uint32_t storeSector = 0; // Erase unit
+static int32_t storeNewest = -1; // Slot of the newest valid record, -1: none
+static SettingsRecord storeRecord; // Newest record (or staged one)
+static bool storeDirty = false;
+
+static uint32_t storeCrc(const SettingsRecord &rec)
+{
+    const uint8_t *p = (const uint8_t *)&rec;
+    uint32_t crc = 0xffffffff;
+
+    for (uint32_t i = 0; i < offsetof(SettingsRecord, crc); i++)
+    {
+        crc ^= p[i];
+        for (int b = 0; b < 8; b++)
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+static bool storeReadSlot(uint32_t slot, SettingsRecord &rec)
+{
+    return halFlashRead(slot * sizeof(SettingsRecord), &rec, sizeof(rec));
+}
+
+static bool storeIsValid(const SettingsRecord &rec)
+{
+    return rec.magic == settingsMagic && rec.version != 0 && rec.version <= settingsSchemaVersion &&
+           rec.crc == storeCrc(rec);
+}
+
+static bool storeIsEmpty(uint32_t slot)
+{
+    SettingsRecord rec;
+    return storeReadSlot(slot, rec) && rec.magic == 0xff;
+}
+
+// Whole slots, not only the magic: an erase cut short leaves old records behind
+static bool storeSectorIsErased(uint32_t firstSlot)
+{
+    SettingsRecord rec;
+    const uint8_t *p = (const uint8_t *)&rec;
+
+    for (uint32_t slot = firstSlot; slot < firstSlot + storeSector / sizeof(SettingsRecord); slot++)
+    {
+        if (!storeReadSlot(slot, rec))
+            return false;
+        for (uint32_t i = 0; i < sizeof(rec); i++)
+        {
+            if (p[i] != 0xff)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Newest record: the sector whose first record has the largest sequence number
+// holds it, and inside a sector slots are filled in order, so a binary search finds
+// the last written slot. Cost: one read per sector + log2(slots per sector).
+static int32_t storeFindNewest()
+{
+    uint32_t slotsPerSector = storeSector / sizeof(SettingsRecord);
+    uint32_t sectors = storeSize / storeSector;
+    int32_t bestSector = -1;
+    uint16_t bestSeq = 0;
+    SettingsRecord rec;
+
+    for (uint32_t s = 0; s < sectors; s++)
+    {
+        if (!storeReadSlot(s * slotsPerSector, rec) || rec.magic != settingsMagic)
+            continue;
+        if (bestSector < 0 || (int16_t)(rec.seq - bestSeq) > 0)
+        {
+            bestSector = s;
+            bestSeq = rec.seq;
+        }
+    }
+    if (bestSector < 0)
+        return -1;
+
+    uint32_t first = bestSector * slotsPerSector;
+    uint32_t lo = 0, hi = slotsPerSector; // Slot lo is written, hi is empty (or end)
+    while (hi - lo > 1)
+    {
+        uint32_t mid = (lo + hi) / 2;
+        if (storeIsEmpty(first + mid))
+            hi = mid;
+        else
+            lo = mid;
+    }
+
+    // A torn write leaves a bad last record: step back to the previous good one
+    uint32_t slots = storeSize / sizeof(SettingsRecord);
+    uint32_t slot = first + lo;
+    for (uint32_t i = 0; i < slots; i++)
+    {
+        if (storeReadSlot(slot, rec) && storeIsValid(rec))
+            return slot;
+        slot = (slot + slots - 1) % slots;
+        if (storeIsEmpty(slot))
+            break;
+    }
+    return -1;
+}
+
+bool settingsStoreBegin()
+{
+    storeSize = halFlashBegin(storeSector);
+    // One sector would be erased with the only good record in it when the log wraps
+    if (storeSize / 2 < storeSector || storeSector < sizeof(SettingsRecord))
+    {
+        storeSize = 0;
+        return false;
+    }
+    storeNewest = storeFindNewest();
+    if (storeNewest >= 0)
+        storeReadSlot(storeNewest, storeRecord);
+    storeDirty = false;
+    return true;
+}
+
+// Copy the newest record. Returns false if there is none.
+// version: schema version the payload was written with. The next commit
+// writes it with the current version.
+bool settingsStoreLoad(uint8_t *payload, uint8_t &version)
+{
+    if (storeNewest < 0)
+        return false;
+    memcpy(payload, storeRecord.payload, settingsPayloadSize);
+    version = storeRecord.version;
+    return true;
+}
+
+// Keep the new settings in RAM only. Writing the same values again is free.
+void settingsStoreStage(const uint8_t *payload)
+{
+    if (memcmp(payload, storeRecord.payload, settingsPayloadSize) == 0 && storeNewest >= 0)
+        return;
+    memcpy(storeRecord.payload, payload, settingsPayloadSize);
+    storeDirty = true;
+}
+
+// Append the staged settings as a new record
+bool settingsStoreCommit()
+{
+    if (!storeDirty || storeSize == 0)
+        return storeSize != 0;
+
+    uint32_t slots = storeSize / sizeof(SettingsRecord);
+    uint32_t slotsPerSector = storeSector / sizeof(SettingsRecord);
+    uint32_t slot = storeNewest < 0 ? 0 : (storeNewest + 1) % slots;
+
+    // Past what a torn write left after the newest record, in the same sector
+    while (slot % slotsPerSector != 0 && !storeIsEmpty(slot))
+        slot = (slot + 1) % slots;
+    // Log wrapped into a used sector: erase it (it holds the oldest records)
+    if (slot % slotsPerSector == 0 && !storeSectorIsErased(slot))
+    {
+        if (!halFlashErase(slot * sizeof(SettingsRecord), storeSector))
+            return false;
+    }
+
+    storeRecord.magic = settingsMagic;
+    storeRecord.version = settingsSchemaVersion;
+    storeRecord.seq = storeNewest < 0 ? 0 : storeRecord.seq + 1;
+    storeRecord.crc = storeCrc(storeRecord);
+    if (!halFlashWrite(slot * sizeof(SettingsRecord), &storeRecord, sizeof(storeRecord)))
+        return false;
+
+    storeNewest = slot;
+    storeDirty = false;
+    return true;
+}
+
+uint16_t settingsStoreSequence()
+{
+    return storeRecord.seq;
+}
@@ -0,0 +1,21 @@
+//
+//  Settings store
+//    Append-only log of settings records in a flash region, so a settings change
+//    programs one 16 byte slot instead of erasing a sector.
+//    Each record has a schema version, a sequence number and a CRC32. Sectors are
+//    used in turn; a sector is erased only when the log wraps around to it, so the
+//    region needs two sectors at least.
+//    Changes are staged in RAM and written by settingsStoreCommit().
+//
+#pragma once
+
+#include <stdint.h>
+
+const uint8_t settingsPayloadSize = 8;
+const uint8_t settingsSchemaVersion = 3; // Older records are loaded as they are, see settingsStoreLoad()
+
+bool settingsStoreBegin();
+bool settingsStoreLoad(uint8_t *payload, uint8_t &version);
+void settingsStoreStage(const uint8_t *payload);
+bool settingsStoreCommit();
+uint16_t settingsStoreSequence();
@@ -0,0 +1,61 @@
+//
+//  Bounded single producer / single consumer queue
+//    Lock free: push() only from one task (or ISR), pop() only from one other task.
+//    N must be a power of 2. One slot is kept empty, so it holds N - 1 items.
+//
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+template <typename T, uint16_t N>
+class SpscQueue
+{
+    static_assert((N & (N - 1)) == 0, "SpscQueue size must be power of 2");
+
+public:
+    // Producer side. Returns false (item dropped) when full.
+    bool push(const T &item)
+    {
+        uint16_t head = head_.load(std::memory_order_relaxed);
+        uint16_t next = (head + 1) & (N - 1);
+
+        if (next == tail_.load(std::memory_order_acquire))
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items_[head] = item;
+        head_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side
+    bool pop(T &item)
+    {
+        uint16_t tail = tail_.load(std::memory_order_relaxed);
+
+        if (tail == head_.load(std::memory_order_acquire))
+            return false;
+        item = items_[tail];
+        tail_.store((tail + 1) & (N - 1), std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: discard everything queued so far
+    void clear()
+    {
+        tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    uint32_t dropped() const
+    {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    T items_[N];
+    std::atomic<uint16_t> head_{0};
+    std::atomic<uint16_t> tail_{0};
+    std::atomic<uint32_t> dropped_{0};
+};
@@ -0,0 +1,267 @@
+//
+//  Raw sensor telemetry
+//
+
+#include <atomic>
+#include "hal.h"
+#include "spsc_queue.h"
+#include "telemetry.h"
+
+static SpscQueue<AdcSample, 256> telemetryRing; // ~250ms at 1kHz
+static std::atomic<bool> isTelemetryOn(false);
+static bool isTelemetryBegun = false;
+static uint16_t telemetrySequence;
+static uint32_t telemetryPacketCount;
+static uint8_t telemetryFrame[telemetryFrameMax];
+static uint32_t telemetryFrameLen; // Packed frame waiting for room in the UART, 0: none
+
+static uint8_t *put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v)
+{
+    return put16(put16(p, v), v >> 16);
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+// Small magnitudes of either sign -> small unsigned: 0, -1, 1, -2 ... -> 0, 1, 2, 3 ...
+static uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// 7 bits per byte, low first, top bit set: more follows
+static uint8_t *putVarint(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = v | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static bool getVarint(const uint8_t *&p, const uint8_t *end, uint32_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7)
+    {
+        uint8_t b = *p++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Byte stuffing: the output has no 0x00, so 0x00 can delimit frames
+size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t code = 0; // Where the length of the current block goes
+    size_t o = 1;
+    uint8_t run = 1;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (in[i] != 0)
+        {
+            out[o++] = in[i];
+            if (++run != 0xff)
+                continue;
+        }
+        out[code] = run;
+        code = o++;
+        run = 1;
+    }
+    out[code] = run;
+    return o;
+}
+
+size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t i = 0;
+    size_t o = 0;
+
+    while (i < len)
+    {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > len)
+            return 0;
+        for (int k = 1; k < code; k++)
+            out[o++] = in[i++];
+        if (code != 0xff && i < len)
+            out[o++] = 0;
+    }
+    return o;
+}
+
+// CRC-16/CCITT-FALSE
+uint16_t telemetryCrc16(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xffff;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++)
+            crc = (crc << 1) ^ (0x1021 & (0 - (crc >> 15)));
+    }
+    return crc;
+}
+
+size_t telemetryPackSamples(const AdcSample *samples, int count, uint16_t sequence, uint16_t dropped,
+                            uint8_t *packet)
+{
+    const uint32_t periodUs = 1000000 / sampleRateHz;
+    uint8_t *p = packet;
+
+    *p++ = telemetryTypeSamples;
+    p = put16(p, sequence);
+    p = put16(p, dropped);
+    p = put32(p, samples[0].timeUs);
+    *p++ = count;
+    for (int ch = 0; ch < sampleChannels; ch++)
+        p = put16(p, samples[0].value[ch]);
+    for (int i = 1; i < count; i++)
+    {
+        p = putVarint(p, zigzag((int32_t)(samples[i].timeUs - samples[i - 1].timeUs - periodUs)));
+        for (int ch = 0; ch < sampleChannels; ch++)
+            p = putVarint(p, zigzag((int32_t)samples[i].value[ch] - samples[i - 1].value[ch]));
+    }
+    p = put16(p, telemetryCrc16(packet, p - packet));
+    return p - packet;
+}
+
+// Packs what the ring holds (up to telemetryBatch samples) into telemetryFrame
+static void telemetryPack()
+{
+    uint8_t packet[telemetryPacketMax];
+    AdcSample samples[telemetryBatch];
+    int count = 0;
+    size_t len;
+
+    while (count < telemetryBatch && telemetryRing.pop(samples[count]))
+        count++;
+    if (count == 0)
+        return;
+    len = telemetryPackSamples(samples, count, telemetrySequence++, telemetryRing.dropped(), packet);
+
+    telemetryFrame[0] = 0; // Leading delimiter: text printed in between stays a frame of its own
+    telemetryFrameLen = cobsEncode(packet, len, telemetryFrame + 1) + 1;
+    telemetryFrame[telemetryFrameLen++] = 0;
+}
+
+// Telemetry task: sends the frames that fit, one left over waits for the next poll
+static void telemetryPoll()
+{
+    if (!isTelemetryOn)
+    {
+        telemetryFrameLen = 0;
+        telemetryRing.clear();
+        return;
+    }
+    for (;;)
+    {
+        if (telemetryFrameLen == 0)
+            telemetryPack();
+        if (telemetryFrameLen == 0 || halSerialWritable() < telemetryFrameLen)
+            return;
+        halSerialWrite(telemetryFrame, telemetryFrameLen);
+        telemetryFrameLen = 0;
+        telemetryPacketCount++;
+    }
+}
+
+void telemetryBegin()
+{
+    if (isTelemetryBegun)
+        return;
+    isTelemetryBegun = true;
+    halTaskStartPeriodic("telemetry", telemetryPoll, telemetryPollInterval, telemetryTaskCore);
+}
+
+void telemetryStart()
+{
+    telemetryBegin();
+    isTelemetryOn = true;
+}
+
+void telemetryStop()
+{
+    isTelemetryOn = false;
+}
+
+bool telemetryActive()
+{
+    return isTelemetryOn;
+}
+
+// Sensor task side: O(1), never blocks
+void telemetryPush(const AdcSample &sample)
+{
+    if (isTelemetryOn)
+        telemetryRing.push(sample);
+}
+
+uint32_t telemetryDropped()
+{
+    return telemetryRing.dropped();
+}
+
+uint32_t telemetryPackets()
+{
+    return telemetryPacketCount;
+}
+
+bool telemetryUnpack(const uint8_t *packet, size_t len, TelemetryHeader &header, AdcSample *samples)
+{
+    const uint32_t periodUs = 1000000 / sampleRateHz;
+    const uint8_t *p = packet + 10;
+    const uint8_t *end = packet + len - 2;
+    uint32_t v;
+
+    if (len < 12 + 2 * sampleChannels || packet[0] != telemetryTypeSamples ||
+        telemetryCrc16(packet, len - 2) != get16(end))
+        return false;
+    header.sequence = get16(packet + 1);
+    header.dropped = get16(packet + 3);
+    header.count = packet[9];
+    if (header.count == 0 || header.count > telemetryBatch)
+        return false;
+
+    samples[0].timeUs = get32(packet + 5);
+    for (int ch = 0; ch < sampleChannels; ch++, p += 2)
+        samples[0].value[ch] = get16(p);
+    for (int i = 1; i < header.count; i++)
+    {
+        if (!getVarint(p, end, v))
+            return false;
+        samples[i].timeUs = samples[i - 1].timeUs + periodUs + unzigzag(v);
+        for (int ch = 0; ch < sampleChannels; ch++)
+        {
+            if (!getVarint(p, end, v))
+                return false;
+            samples[i].value[ch] = samples[i - 1].value[ch] + unzigzag(v);
+        }
+    }
+    return p == end;
+}
@@ -0,0 +1,60 @@
+//
+//  Raw sensor telemetry
+//    Streams every ADC sample over Serial as binary packets, for recording real
+//    sessions (host/teledump turns a capture into a replay trace).
+//    The sensor task only copies samples into a ring; a separate task packs and
+//    sends them when the UART has room. If the link can't keep up the ring
+//    fills and new samples are dropped and counted, nothing blocks.
+//
+//    Frame: 0x00, COBS(packet), 0x00. Packet, little endian:
+//      u8  type (telemetryTypeSamples)
+//      u16 sequence, +1 per packet
+//      u16 dropped, samples lost to a full ring so far (wraps)
+//      u32 time of the first sample (us)
+//      u8  sample count
+//      u16 first sample value, per channel
+//      then per following sample: zigzag varint (time step - sample period),
+//      zigzag varint (value - previous value) per channel
+//      u16 CRC-16/CCITT of the bytes above
+//
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sampler.h"
+
+const uint8_t telemetryTypeSamples = 1;
+const int telemetryBatch = 32;                // Samples per packet at most
+const uint32_t telemetryPollInterval = 20;    // Packing task period: 20ms
+const int telemetryTaskCore = 1;
+const uint32_t telemetryTxBuffer = 1024;      // Serial TX buffer, must hold a full frame
+// Worst case: varints of 5 bytes (time) and 2 bytes (12 bit value deltas)
+const int telemetryPacketMax = 12 + 2 * sampleChannels + (telemetryBatch - 1) * (5 + 2 * sampleChannels);
+const int telemetryFrameMax = telemetryPacketMax + telemetryPacketMax / 254 + 3; // COBS + 2 delimiters
+
+static_assert(telemetryFrameMax <= (int)telemetryTxBuffer, "Telemetry frame does not fit the TX buffer");
+
+struct TelemetryHeader
+{
+    uint16_t sequence;
+    uint16_t dropped;
+    uint8_t count;
+};
+
+void telemetryBegin();
+void telemetryStart();
+void telemetryStop();
+bool telemetryActive();
+void telemetryPush(const AdcSample &sample);
+uint32_t telemetryDropped();
+uint32_t telemetryPackets();
+
+//---- Format, shared with the host decoder
+size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out);
+size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out); // 0: malformed
+uint16_t telemetryCrc16(const uint8_t *data, size_t len);
+// Packs samples[count] (1 ~ telemetryBatch) into packet[telemetryPacketMax], returns the length
+size_t telemetryPackSamples(const AdcSample *samples, int count, uint16_t sequence, uint16_t dropped,
+                            uint8_t *packet);
+// Unpacks one decoded packet into samples[telemetryBatch]. False: bad CRC or layout
+bool telemetryUnpack(const uint8_t *packet, size_t len, TelemetryHeader &header, AdcSample *samples);
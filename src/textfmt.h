@@ -0,0 +1,73 @@
+//
+//  Fixed capacity text formatting
+//    Builds short strings on the stack instead of Arduino String, so updating
+//    the screen never allocates from the heap. Text that does not fit is cut.
+//
+#pragma once
+
+#include <stdint.h>
+
+// Write value as decimal. Returns the number of characters (without '\0').
+inline int formatInt(char *buf, int size, int32_t value)
+{
+    char digits[11];
+    int n = 0;
+    int len = 0;
+    uint32_t v = value < 0 ? 0 - (uint32_t)value : (uint32_t)value;
+
+    do
+    {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v != 0);
+    if (value < 0 && len < size - 1)
+        buf[len++] = '-';
+    while (n > 0 && len < size - 1)
+        buf[len++] = digits[--n];
+    buf[len] = '\0';
+    return len;
+}
+
+template <int N>
+class TextBuf
+{
+public:
+    TextBuf() : len_(0) { buf_[0] = '\0'; }
+
+    TextBuf &add(const char *s)
+    {
+        while (*s != '\0' && len_ < N - 1)
+            buf_[len_++] = *s++;
+        buf_[len_] = '\0';
+        return *this;
+    }
+
+    TextBuf &addInt(int32_t value)
+    {
+        len_ += formatInt(buf_ + len_, N - len_, value);
+        return *this;
+    }
+
+    TextBuf &addChar(char c)
+    {
+        if (len_ < N - 1)
+        {
+            buf_[len_++] = c;
+            buf_[len_] = '\0';
+        }
+        return *this;
+    }
+
+    void clear()
+    {
+        len_ = 0;
+        buf_[0] = '\0';
+    }
+
+    const char *c_str() const { return buf_; }
+    int length() const { return len_; }
+
+private:
+    char buf_[N];
+    int len_;
+};
@@ -0,0 +1,168 @@
+//
+//  Deadline timer scheduler
+//
+
+#include "hal.h"
+#include "timer_sched.h"
+
+struct SchedTimer
+{
+    const char *name;
+    void (*callback)();
+    uint32_t deadlineUs;
+    uint32_t periodUs;   // 0: one shot
+    uint32_t remainUs;   // Time left while paused
+    bool active;
+    bool paused;
+    uint32_t fires;
+    uint32_t missed;
+    uint32_t maxLateUs;
+    uint64_t sumLateUs;
+};
+
+static SchedTimer schedTimers[schedTimerMax];
+static int schedTimerNum = 0;
+
+// Returns timer id, -1 if the table is full
+int schedCreate(const char *name, void (*callback)())
+{
+    if (schedTimerNum >= schedTimerMax)
+        return -1;
+    SchedTimer &t = schedTimers[schedTimerNum];
+    t.name = name;
+    t.callback = callback;
+    t.active = false;
+    t.paused = false;
+    return schedTimerNum++;
+}
+
+void schedStartAt(int id, uint32_t deadlineUs, uint32_t periodUs)
+{
+    SchedTimer &t = schedTimers[id];
+    t.deadlineUs = deadlineUs;
+    t.periodUs = periodUs;
+    t.active = true;
+    t.paused = false;
+}
+
+void schedStartIn(int id, uint32_t delayUs, uint32_t periodUs)
+{
+    schedStartAt(id, halMicros() + delayUs, periodUs);
+}
+
+void schedStop(int id)
+{
+    schedTimers[id].active = false;
+    schedTimers[id].paused = false;
+}
+
+// Keep the time left to the deadline, schedResume() continues from there
+void schedPause(int id)
+{
+    SchedTimer &t = schedTimers[id];
+    if (!t.active)
+        return;
+    int32_t remain = (int32_t)(t.deadlineUs - halMicros());
+    t.remainUs = remain > 0 ? remain : 0;
+    t.active = false;
+    t.paused = true;
+}
+
+void schedResume(int id)
+{
+    SchedTimer &t = schedTimers[id];
+    if (!t.paused)
+        return;
+    t.deadlineUs = halMicros() + t.remainUs;
+    t.active = true;
+    t.paused = false;
+}
+
+bool schedActive(int id)
+{
+    return schedTimers[id].active || schedTimers[id].paused;
+}
+
+// Fire every timer whose deadline has passed
+void schedRun()
+{
+    for (int i = 0; i < schedTimerNum; i++)
+    {
+        SchedTimer &t = schedTimers[i];
+        uint32_t now = halMicros();
+        int32_t late = (int32_t)(now - t.deadlineUs);
+
+        if (!t.active || late < 0)
+            continue;
+
+        t.fires++;
+        t.sumLateUs += late;
+        if ((uint32_t)late > t.maxLateUs)
+            t.maxLateUs = late;
+
+        if (t.periodUs == 0)
+        {
+            t.active = false;
+        }
+        else
+        {
+            t.deadlineUs += t.periodUs;
+            // More than a period behind: skip to the next deadline in the future,
+            // still on the original grid
+            if ((int32_t)(now - t.deadlineUs) >= 0)
+            {
+                uint32_t skip = (now - t.deadlineUs) / t.periodUs + 1;
+                t.deadlineUs += skip * t.periodUs;
+                t.missed += skip;
+            }
+        }
+        t.callback();
+    }
+}
+
+// Time until the earliest deadline, 0 if one is due, INT32_MAX if none is active
+int32_t schedUntilNextUs()
+{
+    uint32_t now = halMicros();
+    int32_t next = INT32_MAX;
+
+    for (int i = 0; i < schedTimerNum; i++)
+    {
+        if (!schedTimers[i].active)
+            continue;
+        int32_t until = (int32_t)(schedTimers[i].deadlineUs - now);
+        if (until < next)
+            next = until;
+    }
+    return next < 0 ? 0 : next;
+}
+
+int schedCount()
+{
+    return schedTimerNum;
+}
+
+const char *schedName(int id)
+{
+    return schedTimers[id].name;
+}
+
+void schedGetStats(int id, SchedStats &stats)
+{
+    SchedTimer &t = schedTimers[id];
+    stats.fires = t.fires;
+    stats.missed = t.missed;
+    stats.maxLateUs = t.maxLateUs;
+    stats.meanLateUs = t.fires ? t.sumLateUs / t.fires : 0;
+}
+
+void schedResetStats()
+{
+    for (int i = 0; i < schedTimerNum; i++)
+    {
+        schedTimers[i].fires = 0;
+        schedTimers[i].missed = 0;
+        schedTimers[i].maxLateUs = 0;
+        schedTimers[i].sumLateUs = 0;
+    }
+}
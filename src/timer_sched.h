@@ -0,0 +1,35 @@
+//
+//  Deadline timer scheduler
+//    Timers fire at absolute deadlines (halMicros). A periodic timer's next
+//    deadline is the previous deadline + period, not "now + period", so time
+//    spent drawing or beeping never accumulates into drift.
+//    Callbacks run from schedRun() in loop(), one context, no locking needed.
+//    Lateness (fire time - deadline) is recorded per timer as jitter.
+//
+#pragma once
+
+#include <stdint.h>
+
+const int schedTimerMax = 8;
+
+struct SchedStats
+{
+    uint32_t fires;
+    uint32_t missed;     // Periods skipped because the timer was more than a period late
+    uint32_t maxLateUs;
+    uint32_t meanLateUs;
+};
+
+int schedCreate(const char *name, void (*callback)());
+void schedStartAt(int id, uint32_t deadlineUs, uint32_t periodUs);
+void schedStartIn(int id, uint32_t delayUs, uint32_t periodUs);
+void schedStop(int id);
+void schedPause(int id);
+void schedResume(int id);
+bool schedActive(int id);
+void schedRun();
+int32_t schedUntilNextUs();
+int schedCount();
+const char *schedName(int id);
+void schedGetStats(int id, SchedStats &stats);
+void schedResetStats();
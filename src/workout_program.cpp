@@ -0,0 +1,108 @@
+//
+//  Workout programs
+//
+
+#include <string.h>
+#include "hal.h"
+#include "telemetry.h"
+#include "audio_cue.h"
+#include "rep_counter.h"
+#include "workout_program.h"
+
+static ProgramImage programBuffer; // Loaded or custom program
+static const ProgramImage *programActive = &programBuffer;
+static int programPos;
+
+uint16_t programChecksum(const ProgramImage &image)
+{
+    const uint8_t *p = (const uint8_t *)&image;
+
+    return telemetryCrc16(p + offsetof(ProgramImage, name), sizeof(image) - offsetof(ProgramImage, name));
+}
+
+bool programCheck(const ProgramImage &image)
+{
+    if (image.magic != programMagic || image.stepCount == 0 || image.stepCount > programStepMax ||
+        image.exerciseCount > programExerciseMax || image.name[programNameMax - 1] != 0 ||
+        image.check != programChecksum(image))
+        return false;
+    for (int i = 0; i < image.exerciseCount; i++)
+    {
+        if (image.exercises[i][programExerciseNameMax - 1] != 0)
+            return false;
+    }
+    for (int i = 0; i < image.stepCount; i++)
+    {
+        const ProgramStep &s = image.steps[i];
+        if ((s.reps == 0) == (s.workSec == 0) || s.mode >= countModes || s.cue >= cueItems ||
+            (image.exerciseCount > 0 && s.exercise >= image.exerciseCount))
+            return false;
+    }
+    return true;
+}
+
+void programUse(const ProgramImage &image)
+{
+    programActive = &image;
+    programPos = 0;
+}
+
+bool programLoad(const char *path)
+{
+    if (halFileSize(path) != sizeof(programBuffer) ||
+        !halFileRead(path, 0, &programBuffer, sizeof(programBuffer)) || !programCheck(programBuffer))
+        return false;
+    programUse(programBuffer);
+    return true;
+}
+
+void programUseCustom(uint16_t sets, uint16_t reps, uint16_t restSec, uint8_t mode)
+{
+    ProgramImage &p = programBuffer;
+
+    memset(&p, 0, sizeof(p));
+    p.magic = programMagic;
+    p.stepCount = sets < programStepMax ? sets : programStepMax;
+    strcpy(p.name, "Custom");
+    for (int i = 0; i < p.stepCount; i++)
+        p.steps[i] = ProgramStep{reps, 0, restSec, mode, cueSetStart, 0, {0, 0, 0}};
+    p.check = programChecksum(p);
+    programUse(p);
+}
+
+const ProgramImage &programCurrent()
+{
+    return *programActive;
+}
+
+void programStart()
+{
+    programPos = 0;
+}
+
+const ProgramStep &programStep()
+{
+    return programActive->steps[programPos];
+}
+
+int programStepIndex()
+{
+    return programPos;
+}
+
+bool programNext()
+{
+    if (programPos + 1 >= programActive->stepCount)
+        return false;
+    programPos++;
+    return true;
+}
+
+uint32_t programRepTarget()
+{
+    uint32_t reps = 0;
+
+    for (int i = 0; i < programActive->stepCount; i++)
+        reps += programActive->steps[i].reps;
+    return reps;
+}
@@ -0,0 +1,63 @@
+//
+//  Workout programs
+//    A program is a flat table of steps (sets), each with its own reps or work
+//    time, rest after it, count mode and start cue: pyramids, supersets (rest 0,
+//    the next exercise starts at once) and timed intervals.
+//    Programs are compiled ahead of time by host/progc, into workout_programs.h
+//    (built in, in flash) or into .wkp files for the SD card. A file is one
+//    read into a static buffer, no heap; moving to the next step is an index
+//    increment. ProgramImage is stored as is (little endian on both ends).
+//
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+const uint32_t programMagic = 0x31504b57; // "WKP1"
+const int programStepMax = 32;
+const int programNameMax = 16;
+const int programExerciseMax = 4;
+const int programExerciseNameMax = 12;
+const int programSdSlots = 2;             // /programs/1.wkp, /programs/2.wkp
+
+struct ProgramStep
+{
+    uint16_t reps;     // Target, 0: timed step
+    uint16_t workSec;  // Length of a timed step
+    uint16_t restSec;  // Rest after the step, 0: next step at once (superset)
+    uint8_t mode;      // CountMode
+    uint8_t cue;       // AudioCue at the step start
+    uint8_t exercise;  // Index into ProgramImage::exercises
+    uint8_t reserved[3];
+};
+
+struct ProgramImage
+{
+    uint32_t magic;
+    uint8_t stepCount;
+    uint8_t exerciseCount; // 0: unnamed, nothing shown
+    uint16_t check;        // programChecksum()
+    char name[programNameMax];
+    char exercises[programExerciseMax][programExerciseNameMax];
+    ProgramStep steps[programStepMax];
+};
+
+static_assert(sizeof(ProgramStep) == 12, "Program step layout");
+static_assert(sizeof(ProgramImage) == 456, "Program image layout");
+
+uint16_t programChecksum(const ProgramImage &image); // CRC-16 of the bytes after check
+bool programCheck(const ProgramImage &image);
+
+// Select the current program: a built-in one, a file (false: missing or
+// broken, select another), or sets x reps from the settings
+void programUse(const ProgramImage &image);
+bool programLoad(const char *path);
+void programUseCustom(uint16_t sets, uint16_t reps, uint16_t restSec, uint8_t mode);
+const ProgramImage &programCurrent();
+
+//---- Position in the current program
+void programStart();
+const ProgramStep &programStep();
+int programStepIndex();
+bool programNext(); // False: the step was the last one
+uint32_t programRepTarget(); // Reps of the counted steps
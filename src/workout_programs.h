@@ -0,0 +1,48 @@
+//
+//  Built-in workout programs, generated by host/progc from
+//    pyramid.txt superset.txt hiit.txt
+//  (make programs). Edit the sources, not this file.
+//
+#pragma once
+
+#include "workout_program.h"
+
+const ProgramImage programBuiltin1 = {
+    0x31504b57, 5, 1, 0x356c, "Pyramid",
+    {"Lunge", "", "", ""},
+    {
+        {10, 0, 30, 1, 2, 0, {0, 0, 0}},
+        {15, 0, 45, 1, 2, 0, {0, 0, 0}},
+        {20, 0, 60, 1, 2, 0, {0, 0, 0}},
+        {15, 0, 45, 1, 2, 0, {0, 0, 0}},
+        {10, 0, 0, 1, 2, 0, {0, 0, 0}},
+    }};
+
+const ProgramImage programBuiltin2 = {
+    0x31504b57, 6, 2, 0xcb6a, "Superset",
+    {"Lunge", "Squat", "", ""},
+    {
+        {12, 0, 0, 1, 2, 0, {0, 0, 0}},
+        {15, 0, 60, 2, 3, 1, {0, 0, 0}},
+        {12, 0, 0, 1, 2, 0, {0, 0, 0}},
+        {15, 0, 60, 2, 3, 1, {0, 0, 0}},
+        {12, 0, 0, 1, 2, 0, {0, 0, 0}},
+        {15, 0, 0, 2, 3, 1, {0, 0, 0}},
+    }};
+
+const ProgramImage programBuiltin3 = {
+    0x31504b57, 8, 1, 0x8336, "HIIT",
+    {"Steps", "", "", ""},
+    {
+        {0, 20, 10, 0, 4, 0, {0, 0, 0}},
+        {0, 20, 10, 0, 4, 0, {0, 0, 0}},
+        {0, 20, 10, 0, 4, 0, {0, 0, 0}},
+        {0, 20, 10, 0, 4, 0, {0, 0, 0}},
+        {0, 20, 10, 0, 4, 0, {0, 0, 0}},
+        {0, 20, 10, 0, 4, 0, {0, 0, 0}},
+        {0, 20, 10, 0, 4, 0, {0, 0, 0}},
+        {0, 20, 0, 0, 4, 0, {0, 0, 0}},
+    }};
+
+const ProgramImage *const programBuiltins[] = {&programBuiltin1, &programBuiltin2, &programBuiltin3};
+const int programBuiltinCount = 3;